@@ -0,0 +1,84 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "nativeeventinjector.h"
+
+const qint64 NativeEventInjector::spinThresholdNs;
+
+NativeEventInjector::NativeEventInjector(const QElapsedTimer &clock, int count)
+    : eventQueue(count)
+    , clock(clock)
+{
+    jitterNs.reserve(count); // no reallocation on the sending path
+    debug = qgetenv("NATIVEDEBUG").toInt();
+}
+
+void NativeEventInjector::abort()
+{
+    QMutexLocker locker(&mutex);
+    aborted.storeRelease(1);
+    abortCondition.wakeAll();
+}
+
+void NativeEventInjector::run()
+{
+    int sent = 0;
+    Item item;
+
+    // The queue was filled before start(), so an empty queue means done.
+    while (!aborted.loadAcquire() && eventQueue.pop(&item)) {
+        qint64 remaining = item.deadlineNs - clock.nsecsElapsed();
+        if (remaining > spinThresholdNs) {
+            // Sleep on a condition so that abort() does not wait for the deadline.
+            QMutexLocker locker(&mutex);
+            if (!aborted.loadAcquire())
+                abortCondition.wait(&mutex, (remaining - spinThresholdNs) / 1000000);
+            if (aborted.loadAcquire())
+                break;
+        }
+        while (clock.nsecsElapsed() < item.deadlineNs)
+            ; // spin
+
+        if (item.event) {
+            if (debug > 0)
+                qDebug() << "Sending:" << *item.event;
+            QNativeInput::sendNativeEvent(*item.event);
+        }
+        jitterNs.append(clock.nsecsElapsed() - item.deadlineNs); // after the flush
+
+        if (++sent % progressInterval() == 0)
+            emit progress(sent);
+    }
+
+    emit progress(sent);
+}
@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q_NATIVE_EVENT_INJECTOR
+#define Q_NATIVE_EVENT_INJECTOR
+
+#include <QtCore>
+#include "qnativeevents.h"
+#include "nativeeventqueue.h"
+
+// Sends queued events from a dedicated thread, against absolute deadlines
+// on a clock shared with the producer. Injection timing is then independent
+// of how busy the GUI thread is. All events are pushed before start(); the
+// thread finishes when the queue is empty. progress() is emitted every
+// progressInterval() events.
+class NativeEventInjector : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Item
+    {
+        qint64 deadlineNs;
+        const QNativeEvent *event;
+    };
+    typedef NativeEventQueue<Item> Queue;
+
+    // Deadlines closer than this are met by spinning instead of sleeping.
+    static const qint64 spinThresholdNs = 1000 * 1000;
+
+    // Storage for count events and their jitter is allocated up front.
+    NativeEventInjector(const QElapsedTimer &clock, int count);
+
+    Queue &queue() { return eventQueue; }
+    void abort();
+    int progressInterval() const { return 256; }
+
+    // Valid after the thread has finished.
+    const QVector<qint64> &jitter() const { return jitterNs; }
+
+signals:
+    void progress(int sent);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    Queue eventQueue;
+    QElapsedTimer clock;
+    QAtomicInt aborted;
+    QMutex mutex;
+    QWaitCondition abortCondition;
+    QVector<qint64> jitterNs;
+    int debug;
+};
+
+#endif
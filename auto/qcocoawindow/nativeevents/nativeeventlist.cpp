@@ -32,13 +32,103 @@
 ****************************************************************************/
 
 #include "nativeeventlist.h"
+#include "nativeeventinjector.h"
+#include "qnativeeventstream.h"
+
+static const size_t arenaBlockSize = 64 * 1024;
+static const size_t arenaAlignment = 16;
+
+NativeEventArena::NativeEventArena()
+    : used(arenaBlockSize)
+{
+}
+
+NativeEventArena::~NativeEventArena()
+{
+    clear();
+}
+
+void *NativeEventArena::allocate(size_t size)
+{
+    size = (size + arenaAlignment - 1) & ~(arenaAlignment - 1);
+    if (used + size > arenaBlockSize) {
+        blocks.append(static_cast<char *>(::operator new(arenaBlockSize)));
+        used = 0;
+    }
+    void *memory = blocks.last() + used;
+    used += size;
+    return memory;
+}
+
+QNativeEvent *NativeEventArena::copy(const QNativeEvent &event)
+{
+    switch (event.id()){
+        case QNativeMouseMoveEvent::eventId:
+            return new (allocate(sizeof(QNativeMouseMoveEvent)))
+                QNativeMouseMoveEvent(static_cast<const QNativeMouseMoveEvent &>(event));
+        case QNativeMouseButtonEvent::eventId:
+            return new (allocate(sizeof(QNativeMouseButtonEvent)))
+                QNativeMouseButtonEvent(static_cast<const QNativeMouseButtonEvent &>(event));
+        case QNativeMouseDragEvent::eventId:
+            return new (allocate(sizeof(QNativeMouseDragEvent)))
+                QNativeMouseDragEvent(static_cast<const QNativeMouseDragEvent &>(event));
+        case QNativeMouseWheelEvent::eventId:
+            return new (allocate(sizeof(QNativeMouseWheelEvent)))
+                QNativeMouseWheelEvent(static_cast<const QNativeMouseWheelEvent &>(event));
+        case QNativeKeyEvent::eventId:
+            return new (allocate(sizeof(QNativeKeyEvent)))
+                QNativeKeyEvent(static_cast<const QNativeKeyEvent &>(event));
+        case QNativeModifierEvent::eventId:
+            return new (allocate(sizeof(QNativeModifierEvent)))
+                QNativeModifierEvent(static_cast<const QNativeModifierEvent &>(event));
+        default:
+            qWarning() << "Warning: Cannot store a pure native event. Use a sub class.";
+            return 0;
+    }
+}
+
+void NativeEventArena::clear()
+{
+    foreach (char *block, blocks)
+        ::operator delete(block);
+    blocks.clear();
+    used = arenaBlockSize;
+}
+
+// The timer wakes playback up spinThresholdNs before a deadline, and the
+// sub-millisecond remainder is met by spinning. Playback returns to the
+// event loop between deadlines, so delivery and painting are not starved.
+// The injector thread uses the same threshold.
+static const qint64 spinThresholdNs = NativeEventInjector::spinThresholdNs;
+
+// Upper bucket limits for the jitter histogram. The last bucket is open.
+static const qint64 jitterBucketLimitsNs[] = {
+    10 * 1000, 50 * 1000, 100 * 1000, 250 * 1000, 500 * 1000,
+    1000 * 1000, 2 * 1000 * 1000, 5 * 1000 * 1000, 10 * 1000 * 1000
+};
+static const int jitterBucketCount = sizeof(jitterBucketLimitsNs) / sizeof(jitterBucketLimitsNs[0]) + 1;
 
 NativeEventList::NativeEventList(int defaultWaitMs)
-    : playbackMultiplier(1.0)
+    : deadlineNs(0)
+    , playbackMultiplier(1.0)
     , currIndex(-1)
+    , playing(false)
     , wait(false)
+    , useInjectorThread(qgetenv("NATIVEINJECTORTHREAD").toInt() > 0)
+    , injector(0)
+    , awaitedEvent(0)
+    , backPressureTimeouts(0)
     , defaultWaitMs(defaultWaitMs)
 {
+    // One timer for the whole list: stop() cancels a pending wakeup, which
+    // then can't re-enter sendNextEvent() during a later play().
+    playbackTimer.setSingleShot(true);
+    playbackTimer.setTimerType(Qt::PreciseTimer);
+    connect(&playbackTimer, SIGNAL(timeout()), this, SLOT(sendNextEvent()));
+
+    backPressureTimer.setSingleShot(true);
+    connect(&backPressureTimer, SIGNAL(timeout()), this, SLOT(backPressureTimeout()));
+
     debug = qgetenv("NATIVEDEBUG").toInt();
     QString multiplier = qgetenv("NATIVEDEBUGSPEED");
     if (!multiplier.isEmpty())
@@ -47,56 +137,300 @@ NativeEventList::NativeEventList(int defaultWaitMs)
 
 NativeEventList::~NativeEventList()
 {
-    for (int i=0; i<eventList.size(); i++)
-        delete eventList.takeAt(i).second;
+    // The arena owns the events.
+    stop();
+    delete injector;
 }
 
 void NativeEventList::sendNextEvent()
 {
-    QNativeEvent *e = eventList.at(currIndex).second;
-    if (e) {
+    if (!playing)
+        return;
+
+    // Send the events that are overdue, then wait for the next deadline in
+    // the event loop. Deadlines are absolute, which means that an event which
+    // is sent late does not delay the events following it.
+    bool sent = false;
+    while (playing && currIndex < eventList.size()) {
+        qint64 remaining = deadlineNs - clock.nsecsElapsed();
+        if (remaining > spinThresholdNs || (remaining > 0 && sent)) {
+            playbackTimer.start(int(qMax<qint64>(0, remaining - spinThresholdNs) / 1000000));
+            emit progress(currIndex);
+            return;
+        }
+        while (clock.nsecsElapsed() < deadlineNs)
+            ; // spin for the sub-millisecond remainder
+
+        // Events that share this deadline are flushed together; an event
+        // with a later deadline is flushed on its own, at that deadline.
+        int count = 0;
+        {
+            QNativeEventBatch batch;
+            for (;;) {
+                if (const QNativeEvent *e = eventList.at(currIndex).event) {
+                    if (debug > 0)
+                        qDebug() << "Sending:" << *e;
+                    QNativeInput::sendNativeEvent(*e);
+                }
+                ++count;
+                if (currIndex + 1 >= eventList.size()
+                        || qint64(eventList.at(currIndex + 1).waitNs * playbackMultiplier) != 0)
+                    break;
+                ++currIndex;
+            }
+        }
+
+        // Jitter is measured after the flush, when the events have left the process.
+        const qint64 jitter = clock.nsecsElapsed() - deadlineNs;
+        while (count--)
+            jitterNs.append(jitter);
+        sent = true;
+        waitNextEvent();
+    }
+}
+
+void NativeEventList::waitNextEvent()
+{
+    if (++currIndex >= eventList.size()) {
+        finish();
+        return;
+    }
+
+    deadlineNs += qint64(eventList.at(currIndex).waitNs * playbackMultiplier);
+}
+
+void NativeEventList::finish()
+{
+    if (debug > 0)
+        qDebug().noquote() << jitterReport();
+    emit progress(eventList.size());
+    emit done();
+    stop();
+}
+
+// Returns true if a QEvent of the given type is the delivery of the native event.
+static bool isDeliveryOf(const QNativeEvent &nativeEvent, QEvent::Type type)
+{
+    switch (nativeEvent.id()) {
+        case QNativeMouseMoveEvent::eventId:
+        case QNativeMouseDragEvent::eventId:
+            return type == QEvent::MouseMove;
+        case QNativeMouseButtonEvent::eventId:
+            if (static_cast<const QNativeMouseButtonEvent &>(nativeEvent).clickCount > 0)
+                return type == QEvent::MouseButtonPress || type == QEvent::MouseButtonDblClick;
+            return type == QEvent::MouseButtonRelease;
+        case QNativeMouseWheelEvent::eventId:
+            return type == QEvent::Wheel;
+        case QNativeKeyEvent::eventId:
+            if (static_cast<const QNativeKeyEvent &>(nativeEvent).press)
+                return type == QEvent::KeyPress;
+            return type == QEvent::KeyRelease;
+        case QNativeModifierEvent::eventId:
+            return type == QEvent::KeyPress || type == QEvent::KeyRelease;
+        default:
+            return false;
+    }
+}
+
+// Sends the next event in back-pressure mode and waits for its delivery.
+void NativeEventList::sendAwaitedEvent()
+{
+    if (!playing)
+        return;
+
+    backPressureTimer.stop();
+    while (++currIndex < eventList.size()) {
+        const QNativeEvent *e = eventList.at(currIndex).event;
+        if (!e)
+            continue; // waits do not apply
         if (debug > 0)
             qDebug() << "Sending:" << *e;
+        awaitedEvent = e;
+        backPressureTimer.start();
         QNativeInput::sendNativeEvent(*e);
+        emit progress(currIndex);
+        return;
     }
-    waitNextEvent();
+    awaitedEvent = 0;
+    finish();
 }
 
-void NativeEventList::waitNextEvent()
+void NativeEventList::backPressureTimeout()
 {
-    if (++currIndex >= eventList.size()){
-        emit done();
-        stop();
+    if (!playing || !awaitedEvent)
         return;
+    ++backPressureTimeouts;
+    if (debug > 0)
+        qDebug() << "Timed out waiting for delivery of" << *awaitedEvent;
+    awaitedEvent = 0;
+    sendAwaitedEvent();
+}
+
+bool NativeEventList::eventFilter(QObject *watched, QEvent *event)
+{
+    if (playing && awaitedEvent && watched == backPressureTarget
+            && isDeliveryOf(*awaitedEvent, event->type())) {
+        awaitedEvent = 0;
+        // Send the next event after the target has processed this one.
+        QMetaObject::invokeMethod(this, "sendAwaitedEvent", Qt::QueuedConnection);
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+// Queues the whole list before the thread starts, so that a stalled GUI
+// thread can't starve the injector. The events already live in the arena;
+// only the deadlines are stored. Deadlines are computed here, as in
+// waitNextEvent(), so both playback paths send at the same times.
+void NativeEventList::startInjector()
+{
+    delete injector;
+    injector = new NativeEventInjector(clock, eventList.size());
+    connect(injector, SIGNAL(progress(int)), this, SLOT(injectorProgress(int)), Qt::QueuedConnection);
+    connect(injector, SIGNAL(finished()), this, SLOT(injectorFinished()), Qt::QueuedConnection);
+
+    NativeEventInjector::Queue &queue = injector->queue();
+    qint64 queuedDeadlineNs = 0;
+    foreach (const Entry &entry, eventList) {
+        queuedDeadlineNs += qint64(entry.waitNs * playbackMultiplier);
+        NativeEventInjector::Item item = { queuedDeadlineNs, entry.event };
+        queue.push(item); // can't fail, the queue holds the whole list
     }
+    injector->start(QThread::TimeCriticalPriority);
+}
+
+void NativeEventList::injectorProgress(int sent)
+{
+    if (!playing)
+        return;
+    emit progress(sent);
+}
 
-    int interval = eventList.at(currIndex).first;
-    QTimer::singleShot(interval * playbackMultiplier, this, SLOT(sendNextEvent()));
+void NativeEventList::injectorFinished()
+{
+    if (!playing)
+        return;
+    jitterNs = injector->jitter();
+    finish();
 }
 
 void NativeEventList::append(QNativeEvent *event)
 {
-    eventList.append(QPair<int, QNativeEvent *>(defaultWaitMs, event));
+    append(defaultWaitMs, event);
 }
 
 void NativeEventList::append(int waitMs, QNativeEvent *event)
 {
-    eventList.append(QPair<int, QNativeEvent *>(waitMs, event));
+    Entry entry = { qint64(waitMs) * 1000000, event ? arena.copy(*event) : 0 };
+    eventList.append(entry);
+    delete event;
 }
 
-void NativeEventList::play(Playback playback)
+void NativeEventList::append(const QNativeEvent &event)
+{
+    append(defaultWaitMs, event);
+}
+
+void NativeEventList::append(int waitMs, const QNativeEvent &event)
+{
+    appendNs(qint64(waitMs) * 1000000, event);
+}
+
+void NativeEventList::appendNs(qint64 waitNs, const QNativeEvent &event)
+{
+    Entry entry = { waitNs, arena.copy(event) };
+    eventList.append(entry);
+}
+
+void NativeEventList::appendNs(qint64 waitNs)
+{
+    Entry entry = { waitNs, 0 };
+    eventList.append(entry);
+}
+
+void NativeEventList::reserve(int count)
+{
+    eventList.reserve(count);
+}
+
+bool NativeEventList::load(const QString &fileName)
 {
-    waitNextEvent();
+    QNativeEventStreamReader reader(fileName);
+    if (!reader.isValid()) {
+        qWarning() << "NativeEventList: Cannot load" << fileName;
+        return false;
+    }
+
+    // Recorded timestamps are absolute; the list stores the wait before each event.
+    qint64 lastTimestamp = 0;
+    qint64 timestamp = 0;
+    while (const QNativeEvent *event = reader.readNext(&timestamp)) {
+        appendNs(timestamp - lastTimestamp, *event);
+        lastTimestamp = timestamp;
+    }
+    return !reader.hasError();
+}
+
+bool NativeEventList::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "NativeEventList: Cannot save" << fileName << file.errorString();
+        return false;
+    }
+
+    // Wait-only entries have no record; their wait carries over to the next event.
+    QNativeEventStreamWriter writer(&file);
+    qint64 timestamp = 0;
+    foreach (const Entry &entry, eventList) {
+        timestamp += entry.waitNs;
+        if (entry.event)
+            writer.write(*entry.event, timestamp);
+    }
+    return writer.flush();
+}
 
+void NativeEventList::play(Playback playback)
+{
+    jitterNs.clear();
+    jitterNs.reserve(eventList.size());
+    currIndex = -1;
+    deadlineNs = 0;
+    playing = true;
     wait = (playback == WaitUntilFinished);
+    clock.start();
+
+    if (backPressureTarget) {
+        backPressureTimeouts = 0;
+        sendAwaitedEvent();
+    } else if (useInjectorThread) {
+        startInjector();
+    } else {
+        waitNextEvent();
+        if (playing)
+            sendNextEvent();
+    }
+
     while (wait)
         QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
 }
 
 void NativeEventList::stop()
 {
-    wait = false;
-    QAbstractEventDispatcher::instance()->interrupt();
+    if (injector) {
+        injector->abort();
+        injector->wait();
+    }
+    playbackTimer.stop();
+    backPressureTimer.stop();
+    awaitedEvent = 0;
+    playing = false;
+    // Wake up play() if it is waiting. There may be no dispatcher, for
+    // example when a list is destroyed after the application.
+    if (wait) {
+        wait = false;
+        if (QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance())
+            dispatcher->interrupt();
+    }
 }
 
 void NativeEventList::setTimeMultiplier(float multiplier)
@@ -104,3 +438,68 @@ void NativeEventList::setTimeMultiplier(float multiplier)
     playbackMultiplier = multiplier;
 }
 
+void NativeEventList::setUseInjectorThread(bool enable)
+{
+    useInjectorThread = enable;
+}
+
+void NativeEventList::setBackPressureTarget(QObject *target, int timeoutMs)
+{
+    if (backPressureTarget)
+        backPressureTarget->removeEventFilter(this);
+    backPressureTarget = target;
+    backPressureTimer.setInterval(timeoutMs);
+    if (target)
+        target->installEventFilter(this);
+}
+
+int NativeEventList::jitterHistogramBucketCount()
+{
+    return jitterBucketCount;
+}
+
+// Returns the upper limit for the given bucket, or -1 for the last (open) bucket.
+qint64 NativeEventList::jitterHistogramBucketLimitNs(int bucket)
+{
+    return bucket < jitterBucketCount - 1 ? jitterBucketLimitsNs[bucket] : -1;
+}
+
+QVector<int> NativeEventList::jitterHistogram() const
+{
+    QVector<int> histogram(jitterBucketCount, 0);
+    foreach (qint64 jitter, jitterNs) {
+        int bucket = 0;
+        while (bucket < jitterBucketCount - 1 && jitter >= jitterBucketLimitsNs[bucket])
+            ++bucket;
+        ++histogram[bucket];
+    }
+    return histogram;
+}
+
+QString NativeEventList::jitterReport() const
+{
+    QString report;
+    QTextStream s(&report);
+
+    qint64 max = 0;
+    qint64 sum = 0;
+    foreach (qint64 jitter, jitterNs) {
+        max = qMax(max, jitter);
+        sum += jitter;
+    }
+    qint64 mean = jitterNs.isEmpty() ? 0 : sum / jitterNs.size();
+    s << "NativeEventList playback jitter, " << jitterNs.size() << " events, mean "
+      << mean / 1000 << " us, max " << max / 1000 << " us\n";
+
+    QVector<int> histogram = jitterHistogram();
+    qint64 lower = 0;
+    for (int i = 0; i < jitterBucketCount; ++i) {
+        qint64 upper = jitterHistogramBucketLimitNs(i);
+        QString range = (upper < 0) ? QString(">= %1 us").arg(lower / 1000)
+                                    : QString("%1 - %2 us").arg(lower / 1000).arg(upper / 1000);
+        s << "  " << range.leftJustified(16) << " " << histogram.at(i) << "\n";
+        lower = upper;
+    }
+    s.flush();
+    return report;
+}
@@ -37,6 +37,30 @@
 #include <QtCore>
 #include "qnativeevents.h"
 
+class NativeEventInjector;
+
+// Owns the events of a NativeEventList. Events are copied into large
+// contiguous blocks in append order and are never freed individually.
+// The QNativeEvent classes only have trivially destructible members,
+// which means teardown can release the blocks without running the
+// event destructors.
+class NativeEventArena
+{
+public:
+    NativeEventArena();
+    ~NativeEventArena();
+
+    QNativeEvent *copy(const QNativeEvent &event);
+    void clear();
+
+private:
+    Q_DISABLE_COPY(NativeEventArena)
+    void *allocate(size_t size);
+
+    QVector<char *> blocks;
+    size_t used;
+};
+
 class NativeEventList : public QObject
 {
     Q_OBJECT;
@@ -47,26 +71,90 @@ class NativeEventList : public QObject
     NativeEventList(int defaultWaitMs = 20);
     ~NativeEventList();
 
+    // The list takes ownership of (and deletes) heap allocated events.
     void append(QNativeEvent *event);
     void append(int waitMs, QNativeEvent *event = 0);
+    // Copies the event, no heap allocation per event.
+    void append(const QNativeEvent &event);
+    void append(int waitMs, const QNativeEvent &event);
+    // Sub-millisecond spacing: the wait is given in nanoseconds.
+    void appendNs(qint64 waitNs, const QNativeEvent &event);
+    void appendNs(qint64 waitNs); // a wait with no event
+    void reserve(int count);
+    // Reads and writes the QNativeEventStream format, for example a file
+    // recorded by QNativeEventRecorder. load() appends to the list.
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+    int count() const { return eventList.size(); }
+    const QNativeEvent *eventAt(int index) const { return eventList.at(index).event; }
+    qint64 waitNsAt(int index) const { return eventList.at(index).waitNs; }
 
     void play(Playback playback = WaitUntilFinished);
     void stop();
     void setTimeMultiplier(float multiplier);
+    // Send events from a dedicated injector thread instead of the GUI
+    // thread, so that GUI thread stalls do not delay injection. The GUI
+    // thread then only refills the injector queue and receives progress()
+    // and done(). Also enabled by setting NATIVEINJECTORTHREAD=1.
+    void setUseInjectorThread(bool enable);
+    // Back-pressure playback: ignore the waits and send each event as soon
+    // as the previous one has been delivered to target, for example a
+    // QWindow. Events that are not delivered within timeoutMs are counted
+    // in timeoutCount() and playback continues. jitter() is not recorded in
+    // this mode. Pass 0 to disable.
+    void setBackPressureTarget(QObject *target, int timeoutMs = 1000);
+    int timeoutCount() const { return backPressureTimeouts; }
+
+    // Playback timing. Events are sent against absolute deadlines measured
+    // from the start of play(); jitter() holds how late (in nanoseconds)
+    // each event was sent during the last playback.
+    const QVector<qint64> &jitter() const { return jitterNs; }
+    QVector<int> jitterHistogram() const;
+    QString jitterReport() const;
+    static int jitterHistogramBucketCount();
+    static qint64 jitterHistogramBucketLimitNs(int bucket);
 
 signals:
     void done();
+    void progress(int sent);
 
 private slots:
     void sendNextEvent();
+    void injectorProgress(int sent);
+    void injectorFinished();
+    void sendAwaitedEvent();
+    void backPressureTimeout();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) Q_DECL_OVERRIDE;
 
 private:
     void waitNextEvent();
+    void finish();
+    void startInjector();
+
+    struct Entry
+    {
+        qint64 waitNs;
+        const QNativeEvent *event;
+    };
 
-    QList<QPair<int, QNativeEvent *> > eventList;
+    NativeEventArena arena;
+    QVector<Entry> eventList;
+    QVector<qint64> jitterNs;
+    QElapsedTimer clock;
+    QTimer playbackTimer;
+    qint64 deadlineNs;
     float playbackMultiplier;
     int currIndex;
+    bool playing;
     bool wait;
+    bool useInjectorThread;
+    NativeEventInjector *injector;
+    QPointer<QObject> backPressureTarget;
+    QTimer backPressureTimer;
+    const QNativeEvent *awaitedEvent;
+    int backPressureTimeouts;
     int defaultWaitMs;
     int debug;
 };
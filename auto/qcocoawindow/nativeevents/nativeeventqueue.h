@@ -0,0 +1,90 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q_NATIVE_EVENT_QUEUE
+#define Q_NATIVE_EVENT_QUEUE
+
+#include <QtCore>
+
+// Single producer, single consumer ring buffer. The producer and the
+// consumer threads never block each other: push() fails when the queue is
+// full and pop() fails when it is empty. All storage is allocated up front;
+// the capacity is rounded up to a power of two.
+template <typename Item>
+class NativeEventQueue
+{
+public:
+    explicit NativeEventQueue(int capacity)
+    {
+        int size = 1;
+        while (size < capacity)
+            size *= 2;
+        items.resize(size);
+        mask = size - 1;
+    }
+
+    // Producer side
+    bool push(const Item &item)
+    {
+        quint32 t = tail.load();
+        if (t - head.loadAcquire() > quint32(mask))
+            return false;
+        items[t & mask] = item;
+        tail.storeRelease(t + 1);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(Item *item)
+    {
+        quint32 h = head.load();
+        if (h == tail.loadAcquire())
+            return false;
+        *item = items.at(h & mask);
+        head.storeRelease(h + 1);
+        return true;
+    }
+
+    bool isEmpty() const { return head.loadAcquire() == tail.loadAcquire(); }
+
+    int capacity() const { return mask + 1; }
+
+private:
+    Q_DISABLE_COPY(NativeEventQueue)
+    QVector<Item> items;
+    int mask;
+    QAtomicInteger<quint32> head; // written by the consumer only
+    QAtomicInteger<quint32> tail; // written by the producer only
+};
+
+#endif
@@ -0,0 +1,29 @@
+# Native event generation and recording. Include from projects
+# that send or observe native input events.
+INCLUDEPATH += $$PWD
+HEADERS += \
+    $$PWD/nativeeventinjector.h \
+    $$PWD/nativeeventlist.h \
+    $$PWD/nativeeventqueue.h \
+    $$PWD/nativeeventtransform.h \
+    $$PWD/qnativeeventrecorder.h \
+    $$PWD/qnativeevents.h \
+    $$PWD/qnativeeventstream.h \
+    $$PWD/qnativeeventvariant.h
+SOURCES += \
+    $$PWD/nativeeventinjector.cpp \
+    $$PWD/nativeeventlist.cpp \
+    $$PWD/nativeeventtransform.cpp \
+    $$PWD/qnativeeventrecorder.cpp \
+    $$PWD/qnativeevents.cpp \
+    $$PWD/qnativeeventstream.cpp
+
+mac {
+    SOURCES += $$PWD/qnativeevents_mac.cpp
+    LIBS += -framework Carbon
+} else:unix {
+    # X11 backend: XTest for injection, XRecord for subscription.
+    # Runs against any X server, for example a headless Xvfb.
+    SOURCES += $$PWD/qnativeevents_x11.cpp
+    LIBS += -lX11 -lXtst
+}
@@ -0,0 +1,195 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "nativeeventtransform.h"
+
+//  ************************************************************
+//  NativeEventCompactor
+//  ************************************************************
+
+NativeEventCompactor::NativeEventCompactor()
+    : timeBudgetNs(16 * 1000 * 1000) // one frame at 60 Hz
+    , distanceBudget(8)
+    , inCount(0)
+    , outCount(0)
+    , coalescedCount(0)
+    , droppedModifierCount(0)
+{
+}
+
+// Returns true if b can replace a in a coalesced run.
+static bool isCoalescable(const QNativeEvent *a, const QNativeEvent *b)
+{
+    if (!a || !b || a->id() != b->id() || a->modifiers != b->modifiers)
+        return false;
+    switch (a->id()) {
+        case QNativeMouseMoveEvent::eventId:
+            return true;
+        case QNativeMouseDragEvent::eventId:
+            return static_cast<const QNativeMouseDragEvent *>(a)->button
+                == static_cast<const QNativeMouseDragEvent *>(b)->button;
+        default:
+            return false;
+    }
+}
+
+static QPoint eventPos(const QNativeEvent *e)
+{
+    return static_cast<const QNativeMouseEvent *>(e)->globalPos;
+}
+
+void NativeEventCompactor::compact(const NativeEventList &input, NativeEventList *output)
+{
+    inCount = input.count();
+    outCount = 0;
+    coalescedCount = 0;
+    droppedModifierCount = 0;
+
+    Qt::KeyboardModifiers modifierState = Qt::NoModifier;
+    qint64 timestamp = 0;       // send time of the current input event
+    qint64 lastOutTimestamp = 0;
+
+    // The pending event is the last event of the current run; it is emitted
+    // when the run ends.
+    const QNativeEvent *pending = 0;
+    qint64 pendingTimestamp = 0;
+    const QNativeEvent *runStart = 0;
+    qint64 runStartTimestamp = 0;
+
+    for (int i = 0; i < input.count(); ++i) {
+        timestamp += input.waitNsAt(i);
+        const QNativeEvent *event = input.eventAt(i);
+        if (!event)
+            continue; // wait-only entry, the wait carries over
+
+        if (event->id() == QNativeModifierEvent::eventId) {
+            if (event->modifiers == modifierState) {
+                ++droppedModifierCount;
+                continue;
+            }
+            modifierState = event->modifiers;
+        }
+
+        if (pending && isCoalescable(runStart, event)
+                && timestamp - runStartTimestamp <= timeBudgetNs
+                && (eventPos(event) - eventPos(runStart)).manhattanLength() <= distanceBudget) {
+            pending = event;
+            pendingTimestamp = timestamp;
+            ++coalescedCount;
+            continue;
+        }
+
+        if (pending) {
+            output->appendNs(pendingTimestamp - lastOutTimestamp, *pending);
+            lastOutTimestamp = pendingTimestamp;
+            ++outCount;
+        }
+        pending = event;
+        pendingTimestamp = timestamp;
+        runStart = event;
+        runStartTimestamp = timestamp;
+    }
+
+    if (pending) {
+        output->appendNs(pendingTimestamp - lastOutTimestamp, *pending);
+        lastOutTimestamp = pendingTimestamp;
+        ++outCount;
+    }
+
+    // Keep trailing waits, so that the total playback time is unchanged.
+    if (timestamp > lastOutTimestamp)
+        output->appendNs(timestamp - lastOutTimestamp);
+}
+
+QString NativeEventCompactor::report() const
+{
+    return QString("NativeEventCompactor: %1 -> %2 events (%3x), %4 moves/drags coalesced, "
+                   "%5 modifier events dropped")
+        .arg(inCount).arg(outCount).arg(compressionRatio(), 0, 'f', 2)
+        .arg(coalescedCount).arg(droppedModifierCount);
+}
+
+//  ************************************************************
+//  NativeEventGenerator
+//  ************************************************************
+
+qint64 NativeEventGenerator::intervalNs(int rateHz)
+{
+    return rateHz > 0 ? 1000000000LL / rateHz : 0;
+}
+
+static QPoint interpolate(QPoint from, QPoint to, int step, int steps)
+{
+    if (steps <= 0)
+        return to;
+    return from + (to - from) * step / steps;
+}
+
+void NativeEventGenerator::mouseMoves(NativeEventList *list, QPoint from, QPoint to, int rateHz, int durationMs)
+{
+    qint64 interval = intervalNs(rateHz);
+    int steps = int(qint64(durationMs) * rateHz / 1000);
+    list->reserve(list->count() + steps + 1);
+    for (int i = 0; i <= steps; ++i)
+        list->appendNs(i ? interval : 0, QNativeMouseMoveEvent(interpolate(from, to, i, steps)));
+}
+
+void NativeEventGenerator::mouseDrag(NativeEventList *list, QPoint from, QPoint to, int rateHz, int durationMs,
+                                     Qt::MouseButton button)
+{
+    qint64 interval = intervalNs(rateHz);
+    int steps = int(qint64(durationMs) * rateHz / 1000);
+    list->reserve(list->count() + steps + 2);
+    list->appendNs(0, QNativeMouseButtonEvent(from, button, 1));
+    for (int i = 1; i <= steps; ++i)
+        list->appendNs(interval, QNativeMouseDragEvent(interpolate(from, to, i, steps), button));
+    list->appendNs(interval, QNativeMouseButtonEvent(to, button, 0));
+}
+
+void NativeEventGenerator::keyRepeat(NativeEventList *list, int nativeKeyCode, QChar character, int rateHz,
+                                     int count, Qt::KeyboardModifiers modifiers)
+{
+    qint64 interval = intervalNs(rateHz);
+    list->reserve(list->count() + count + 1);
+    for (int i = 0; i < count; ++i)
+        list->appendNs(i ? interval : 0, QNativeKeyEvent(nativeKeyCode, true, character, modifiers));
+    list->appendNs(interval, QNativeKeyEvent(nativeKeyCode, false, character, modifiers));
+}
+
+void NativeEventGenerator::wheelBurst(NativeEventList *list, QPoint pos, int delta, int rateHz, int count)
+{
+    qint64 interval = intervalNs(rateHz);
+    list->reserve(list->count() + count);
+    for (int i = 0; i < count; ++i)
+        list->appendNs(i ? interval : 0, QNativeMouseWheelEvent(pos, delta));
+}
@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q_NATIVE_EVENT_TRANSFORM
+#define Q_NATIVE_EVENT_TRANSFORM
+
+#include <QtCore>
+#include "qnativeevents.h"
+#include "nativeeventlist.h"
+
+// ----------------------------------------------------------------------------
+// Shrinks recorded event lists. Runs of mouse move events, and of drag events
+// with the same button, are coalesced into their last event as long as the
+// run stays within the time and distance budgets, measured from the first
+// event of the run. Modifier events that do not change the modifier state
+// are dropped. Events keep their original send times, so the compacted list
+// plays back in the same total time.
+// ----------------------------------------------------------------------------
+
+class NativeEventCompactor
+{
+public:
+    NativeEventCompactor();
+
+    void setTimeBudgetNs(qint64 budgetNs) { timeBudgetNs = budgetNs; }
+    void setDistanceBudget(int pixels) { distanceBudget = pixels; }
+
+    // Appends the compacted events of input to output.
+    void compact(const NativeEventList &input, NativeEventList *output);
+
+    int inputCount() const { return inCount; }
+    int outputCount() const { return outCount; }
+    double compressionRatio() const { return outCount ? double(inCount) / outCount : 0.0; }
+    QString report() const;
+
+private:
+    qint64 timeBudgetNs;
+    int distanceBudget;
+    int inCount;
+    int outCount;
+    int coalescedCount;
+    int droppedModifierCount;
+};
+
+// ----------------------------------------------------------------------------
+// Synthesizes high-rate event streams for stress testing the input pipeline.
+// Rates are in events per second; events are spaced evenly, with sub-
+// millisecond precision.
+// ----------------------------------------------------------------------------
+
+class NativeEventGenerator
+{
+public:
+    // Moves the mouse along a straight line, for example at 2000 Hz.
+    static void mouseMoves(NativeEventList *list, QPoint from, QPoint to, int rateHz, int durationMs);
+    // Presses the button at from, drags to to, and releases.
+    static void mouseDrag(NativeEventList *list, QPoint from, QPoint to, int rateHz, int durationMs,
+                          Qt::MouseButton button = Qt::LeftButton);
+    // Auto-repeat style key press flood followed by a single release.
+    static void keyRepeat(NativeEventList *list, int nativeKeyCode, QChar character, int rateHz, int count,
+                          Qt::KeyboardModifiers modifiers = Qt::NoModifier);
+    static void wheelBurst(NativeEventList *list, QPoint pos, int delta, int rateHz, int count);
+
+private:
+    static qint64 intervalNs(int rateHz);
+};
+
+#endif // Q_NATIVE_EVENT_TRANSFORM
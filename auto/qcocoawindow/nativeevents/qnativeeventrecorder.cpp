@@ -0,0 +1,151 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qnativeeventrecorder.h"
+#include "qnativeeventstream.h"
+
+// How long the flush thread sleeps when the ring is empty.
+static const int flushIntervalMs = 10;
+
+class QNativeEventRecorderThread : public QThread
+{
+public:
+    QNativeEventRecorderThread(QNativeEventRecorder::Queue *ring, QIODevice *device)
+        : ring(ring)
+        , writer(device)
+    {
+    }
+
+    void requestStop() { stopRequested.storeRelease(1); }
+    bool hasError() const { return writer.hasError(); }
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        QNativeEventRecorder::Item item;
+        forever {
+            // Read the stop flag before draining: if it was set and the ring
+            // is empty afterwards, all recorded events have been written.
+            bool stopping = stopRequested.loadAcquire();
+            while (ring->pop(&item))
+                writer.write(*item.event.event(), item.timestampNs);
+            writer.flush();
+            if (stopping)
+                break;
+            QThread::msleep(flushIntervalMs);
+        }
+    }
+
+private:
+    QNativeEventRecorder::Queue *ring;
+    QNativeEventStreamWriter writer;
+    QAtomicInt stopRequested;
+};
+
+QNativeEventRecorder::QNativeEventRecorder(const QString &fileName, int capacity)
+    : QNativeInput(false)
+    , ring(capacity)
+    , file(fileName)
+    , thread(0)
+    , recorded(0)
+    , recording(false)
+{
+}
+
+QNativeEventRecorder::~QNativeEventRecorder()
+{
+    stop();
+    delete thread;
+}
+
+bool QNativeEventRecorder::start()
+{
+    if (recording)
+        return true;
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "QNativeEventRecorder: Cannot open" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    delete thread;
+    thread = new QNativeEventRecorderThread(&ring, &file);
+    thread->start(QThread::LowPriority);
+
+    recorded = 0;
+    dropped.store(0);
+    clock.start();
+    recording = true;
+    if (subscribeForNativeEvents() != Qt::Native::Success) {
+        qWarning() << "QNativeEventRecorder: Cannot subscribe for native events";
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void QNativeEventRecorder::stop()
+{
+    if (!recording)
+        return;
+
+    unsubscribeForNativeEvents();
+    recording = false;
+
+    thread->requestStop();
+    thread->wait();
+    file.close();
+
+    if (dropped.load() > 0)
+        qWarning() << "QNativeEventRecorder: Dropped" << dropped.load() << "events, the ring buffer was full";
+}
+
+bool QNativeEventRecorder::hasError() const
+{
+    return thread && thread->hasError();
+}
+
+// Called from the event tap. Must not allocate or block.
+void QNativeEventRecorder::nativeEvent(QNativeEvent *event)
+{
+    if (!recording)
+        return;
+
+    Item item = { clock.nsecsElapsed(), QNativeEventVariant::fromEvent(*event) };
+    if (!item.event.isValid())
+        return;
+    if (ring.push(item))
+        ++recorded;
+    else
+        dropped.ref();
+}
@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q_NATIVE_EVENT_RECORDER
+#define Q_NATIVE_EVENT_RECORDER
+
+#include <QtCore>
+#include "qnativeevents.h"
+#include "qnativeeventvariant.h"
+#include "nativeeventqueue.h"
+
+class QNativeEventRecorderThread;
+
+// ----------------------------------------------------------------------------
+// Records the native input events observed by QNativeInput to a file in the
+// QNativeEventStream format, which NativeEventList::load() plays back.
+//
+// The event callbacks only timestamp the event and copy it, by value, into a
+// preallocated ring buffer. A background thread drains the ring and does
+// the encoding and file I/O. Events that arrive while the ring is full are
+// dropped and counted.
+//
+//    QNativeEventRecorder recorder("session.qnev");
+//    recorder.start();
+//    ... // interact
+//    recorder.stop();
+// ----------------------------------------------------------------------------
+
+class QNativeEventRecorder : public QNativeInput
+{
+public:
+    QNativeEventRecorder(const QString &fileName, int capacity = 64 * 1024);
+    ~QNativeEventRecorder();
+
+    bool start();
+    void stop();
+    bool isRecording() const { return recording; }
+
+    int recordedCount() const { return recorded; }
+    int droppedCount() const { return dropped.load(); }
+    bool hasError() const;
+
+    void nativeEvent(QNativeEvent *event) Q_DECL_OVERRIDE;
+
+    struct Item
+    {
+        qint64 timestampNs;
+        QNativeEventVariant event;
+    };
+    typedef NativeEventQueue<Item> Queue;
+
+private:
+    Q_DISABLE_COPY(QNativeEventRecorder)
+
+    Queue ring;
+    QFile file;
+    QElapsedTimer clock;
+    QNativeEventRecorderThread *thread;
+    QAtomicInt dropped;
+    int recorded;
+    bool recording;
+};
+
+#endif // Q_NATIVE_EVENT_RECORDER
@@ -77,8 +77,34 @@ void QNativeInput::nativeEvent(QNativeEvent *event)
     }
 }
 
+// Not atomic: setSendHook() must be called before events are sent, see qnativeevents.h.
+static QNativeInput::SendHook sendHook = 0;
+
+static QElapsedTimer startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+qint64 QNativeInput::monotonicNs()
+{
+    // Thread-safe static initialization; sends may come from an injector thread.
+    static const QElapsedTimer clock = startedClock();
+    return clock.nsecsElapsed();
+}
+
+void QNativeInput::setSendHook(SendHook hook)
+{
+    monotonicNs(); // start the clock
+    sendHook = hook;
+}
+
 Qt::Native::Status QNativeInput::sendNativeEvent(const QNativeEvent &event, int pid)
 {
+    if (sendHook)
+        sendHook(event, monotonicNs());
+
     switch (event.id()){
         case QNativeMouseMoveEvent::eventId:
             return sendNativeMouseMoveEvent(static_cast<const QNativeMouseMoveEvent &>(event));
@@ -99,6 +125,24 @@ Qt::Native::Status QNativeInput::sendNativeEvent(const QNativeEvent &event, int
     }
 }
 
+static thread_local int batchDepth = 0;
+
+QNativeEventBatch::QNativeEventBatch()
+{
+    ++batchDepth;
+}
+
+QNativeEventBatch::~QNativeEventBatch()
+{
+    if (--batchDepth == 0)
+        QNativeInput::flushNativeEvents();
+}
+
+bool QNativeEventBatch::isActive()
+{
+    return batchDepth > 0;
+}
+
 QNativeEvent::QNativeEvent(Qt::KeyboardModifiers modifiers)
     : modifiers(modifiers){}
 
@@ -213,10 +213,42 @@ class QNativeInput
     static Qt::Native::Status sendNativeModifierEvent(const QNativeModifierEvent &event);
     // sendNativeEvent will NOT differ from OS to OS.
     static Qt::Native::Status sendNativeEvent(const QNativeEvent &event, int pid = 0);
+    // Monotonic clock for timestamping sent and received events, in nanoseconds.
+    static qint64 monotonicNs();
+    // Called by sendNativeEvent() with the send time of each event, before the
+    // event is handed to the OS. May be called from an injector thread, so set
+    // the hook before playback starts and do not change it while playing.
+    typedef void (*SendHook)(const QNativeEvent &event, qint64 sendTimeNs);
+    static void setSendHook(SendHook hook);
+    // Delivers events buffered by the backend. Called when the outermost
+    // QNativeEventBatch ends; a no-op for backends that send immediately.
+    static void flushNativeEvents();
 
     // The following methods will differ in implementation from OS to OS:
     Qt::Native::Status subscribeForNativeEvents();
     Qt::Native::Status unsubscribeForNativeEvents();
 };
 
+// ----------------------------------------------------------------------------
+// Groups events sent from the current thread into one burst. Backends that
+// buffer injected events (X11) flush once when the outermost batch ends,
+// instead of once per event:
+//
+//    {
+//        QNativeEventBatch batch;
+//        QNativeInput::sendNativeEvent(press);
+//        QNativeInput::sendNativeEvent(release);
+//    } // flush
+// ----------------------------------------------------------------------------
+
+class QNativeEventBatch
+{
+public:
+    QNativeEventBatch();
+    ~QNativeEventBatch();
+    static bool isActive();
+private:
+    Q_DISABLE_COPY(QNativeEventBatch)
+};
+
 #endif // Q_NATIVE_INPUT
@@ -362,6 +362,11 @@ Qt::Native::Status QNativeInput::sendNativeModifierEvent(const QNativeModifierEv
     return sendNativeModifierEvent_Quartz(event);
 }
 
+void QNativeInput::flushNativeEvents()
+{
+    // CGEventPost delivers immediately.
+}
+
 Qt::Native::Status QNativeInput::subscribeForNativeEvents()
 {
     return insertEventHandler_Quartz(this);
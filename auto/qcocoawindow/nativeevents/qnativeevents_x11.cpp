@@ -0,0 +1,459 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qnativeevents.h"
+#include <QtCore>
+
+#include <X11/Xlib.h>
+#include <X11/Xproto.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/record.h>
+
+//  ************************************************************
+//  X11
+//
+//  Events are injected with XTest and observed with XRecord. This
+//  works with any X server that has the XTEST and RECORD extensions,
+//  including a headless Xvfb (DISPLAY=:99 Xvfb :99 &).
+//
+//  Injected events are buffered by Xlib. They are flushed after each
+//  event, or once at the end of a QNativeEventBatch.
+//
+//  Events may be sent from an injector thread while the GUI thread
+//  services XRecord. A Display must not be used from two threads unless
+//  XInitThreads() was called before any other Xlib call, which can't be
+//  guaranteed once the platform plugin is connected, so each thread
+//  opens its own connection. It is closed when the thread exits.
+//  ************************************************************
+
+struct DisplayConnection_X11
+{
+    DisplayConnection_X11()
+        : display(XOpenDisplay(0))
+    {
+        if (!display) {
+            qWarning("X11NativeEvents: Cannot open display '%s'", qgetenv("DISPLAY").constData());
+        } else {
+            int eventBase, errorBase, major, minor;
+            if (!XTestQueryExtension(display, &eventBase, &errorBase, &major, &minor))
+                qWarning("X11NativeEvents: The X server does not support XTEST");
+        }
+    }
+    ~DisplayConnection_X11()
+    {
+        if (display)
+            XCloseDisplay(display);
+    }
+
+    Display *display;
+};
+
+static Display *display_X11()
+{
+    static thread_local DisplayConnection_X11 connection;
+    return connection.display;
+}
+
+static Qt::Native::Status flushUnlessBatching_X11(Display *display)
+{
+    if (!QNativeEventBatch::isActive())
+        XFlush(display);
+    return Qt::Native::Success;
+}
+
+static Qt::KeyboardModifiers getModifiersFromXState(unsigned int state)
+{
+    Qt::KeyboardModifiers m;
+    if (state & ShiftMask || state & LockMask)
+        m |= Qt::ShiftModifier;
+    if (state & ControlMask)
+        m |= Qt::ControlModifier;
+    if (state & Mod1Mask)
+        m |= Qt::AltModifier;
+    if (state & Mod4Mask)
+        m |= Qt::MetaModifier;
+    return m;
+}
+
+// Modifiers are keys on X11. Press and release modifier keys so that
+// the modifier state matches the event.
+static void setModifiersFromQNativeEvent(Display *display, const QNativeEvent &event)
+{
+    static thread_local Qt::KeyboardModifiers current;
+    static const struct {
+        Qt::KeyboardModifier modifier;
+        KeySym keysym;
+    } modifierKeys[] = {
+        { Qt::ShiftModifier, XK_Shift_L },
+        { Qt::ControlModifier, XK_Control_L },
+        { Qt::AltModifier, XK_Alt_L },
+        { Qt::MetaModifier, XK_Super_L },
+    };
+
+    for (size_t i = 0; i < sizeof(modifierKeys) / sizeof(modifierKeys[0]); ++i) {
+        bool wanted = event.modifiers.testFlag(modifierKeys[i].modifier);
+        if (wanted == current.testFlag(modifierKeys[i].modifier))
+            continue;
+        KeyCode keyCode = XKeysymToKeycode(display, modifierKeys[i].keysym);
+        XTestFakeKeyEvent(display, keyCode, wanted, CurrentTime);
+    }
+    current = event.modifiers;
+}
+
+static unsigned int getXButton(Qt::MouseButton button)
+{
+    switch (button) {
+        case Qt::LeftButton: return Button1;
+        case Qt::MidButton: return Button2;
+        case Qt::RightButton: return Button3;
+        default: return Button1;
+    }
+}
+
+static QChar getCharFromKeyCode(Display *display, unsigned int keyCode, unsigned int state)
+{
+    KeySym keysym = XkbKeycodeToKeysym(display, keyCode, 0, (state & ShiftMask) ? 1 : 0);
+    if (keysym >= 0x20 && keysym <= 0xff) // Latin-1 keysyms are code points
+        return QChar(ushort(keysym));
+    if ((keysym & 0xff000000) == 0x01000000) // Unicode keysyms
+        return QChar(ushort(keysym & 0xffff));
+    return QChar();
+}
+
+static void RecordHandler_X11(XPointer closure, XRecordInterceptData *data)
+{
+    QNativeInput *nativeInput = reinterpret_cast<QNativeInput *>(closure);
+    if (data->category != XRecordFromServer || !data->data) {
+        XRecordFreeData(data);
+        return;
+    }
+
+    const xEvent *event = reinterpret_cast<const xEvent *>(data->data);
+    int type = event->u.u.type & 0x7f;
+    unsigned int detail = event->u.u.detail;
+    unsigned int state = event->u.keyButtonPointer.state;
+    QPoint pos(event->u.keyButtonPointer.rootX, event->u.keyButtonPointer.rootY);
+    Qt::KeyboardModifiers modifiers = getModifiersFromXState(state);
+
+    switch (type) {
+        case KeyPress:
+        case KeyRelease: {
+            Display *display = display_X11();
+            KeySym keysym = XkbKeycodeToKeysym(display, detail, 0, 0);
+            if (IsModifierKey(keysym)) {
+                // X reports the state from before the event; apply the change.
+                Qt::KeyboardModifiers changed = getModifiersFromXState(
+                    keysym == XK_Shift_L || keysym == XK_Shift_R ? ShiftMask :
+                    keysym == XK_Control_L || keysym == XK_Control_R ? ControlMask :
+                    keysym == XK_Alt_L || keysym == XK_Alt_R ? Mod1Mask :
+                    keysym == XK_Super_L || keysym == XK_Super_R ? Mod4Mask : 0);
+                QNativeModifierEvent e;
+                e.modifiers = (type == KeyPress) ? (modifiers | changed) : (modifiers & ~changed);
+                e.nativeKeyCode = detail;
+                nativeInput->notify(&e);
+                break;
+            }
+            QNativeKeyEvent e;
+            e.modifiers = modifiers;
+            e.nativeKeyCode = detail;
+            e.character = getCharFromKeyCode(display, detail, state);
+            e.press = (type == KeyPress);
+            nativeInput->notify(&e);
+            break;
+        }
+        case ButtonPress:
+        case ButtonRelease: {
+            if (detail == Button4 || detail == Button5) {
+                // Wheel notches arrive as press/release pairs; report the press.
+                if (type == ButtonPress) {
+                    QNativeMouseWheelEvent e;
+                    e.modifiers = modifiers;
+                    e.globalPos = pos;
+                    e.delta = (detail == Button4) ? 1 : -1;
+                    nativeInput->notify(&e);
+                }
+                break;
+            }
+            if (detail > Button3)
+                break;
+            QNativeMouseButtonEvent e;
+            e.modifiers = modifiers;
+            e.globalPos = pos;
+            e.clickCount = (type == ButtonPress) ? 1 : 0;
+            e.button = (detail == Button1) ? Qt::LeftButton :
+                       (detail == Button3) ? Qt::RightButton : Qt::MidButton;
+            nativeInput->notify(&e);
+            break;
+        }
+        case MotionNotify: {
+            if (state & (Button1Mask | Button2Mask | Button3Mask)) {
+                QNativeMouseDragEvent e;
+                e.modifiers = modifiers;
+                e.globalPos = pos;
+                e.clickCount = 1;
+                e.button = (state & Button1Mask) ? Qt::LeftButton :
+                           (state & Button3Mask) ? Qt::RightButton : Qt::MidButton;
+                nativeInput->notify(&e);
+            } else {
+                QNativeMouseMoveEvent e;
+                e.modifiers = modifiers;
+                e.globalPos = pos;
+                nativeInput->notify(&e);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    XRecordFreeData(data);
+}
+
+// XRecord delivers intercepted events on a second connection, which
+// is serviced from the event loop via a socket notifier.
+struct RecordContext_X11
+{
+    Display *dataDisplay;
+    XRecordContext context;
+    QSocketNotifier *notifier;
+};
+
+static QHash<QNativeInput *, RecordContext_X11 *> *recordContexts_X11()
+{
+    static QHash<QNativeInput *, RecordContext_X11 *> contexts;
+    return &contexts;
+}
+
+Qt::Native::Status insertEventHandler_X11(QNativeInput *nativeInput)
+{
+    Display *display = display_X11();
+    if (!display)
+        return Qt::Native::Failure;
+    if (recordContexts_X11()->contains(nativeInput))
+        return Qt::Native::Success;
+
+    int major, minor;
+    if (!XRecordQueryVersion(display, &major, &minor)) {
+        qWarning("X11NativeEvents: The X server does not support RECORD");
+        return Qt::Native::Failure;
+    }
+
+    XRecordRange *range = XRecordAllocRange();
+    if (!range)
+        return Qt::Native::Failure;
+    range->device_events.first = KeyPress;
+    range->device_events.last = MotionNotify;
+    XRecordClientSpec clients = XRecordAllClients;
+    XRecordContext context = XRecordCreateContext(display, 0, &clients, 1, &range, 1);
+    XFree(range);
+    if (!context)
+        return Qt::Native::Failure;
+    XSync(display, False);
+
+    Display *dataDisplay = XOpenDisplay(DisplayString(display));
+    if (!dataDisplay || !XRecordEnableContextAsync(dataDisplay, context, RecordHandler_X11,
+                                                   reinterpret_cast<XPointer>(nativeInput))) {
+        qWarning("X11NativeEvents: Could not enable the record context");
+        if (dataDisplay)
+            XCloseDisplay(dataDisplay);
+        XRecordFreeContext(display, context);
+        return Qt::Native::Failure;
+    }
+
+    RecordContext_X11 *recordContext = new RecordContext_X11;
+    recordContext->dataDisplay = dataDisplay;
+    recordContext->context = context;
+    recordContext->notifier = new QSocketNotifier(ConnectionNumber(dataDisplay), QSocketNotifier::Read);
+    QObject::connect(recordContext->notifier, &QSocketNotifier::activated, [dataDisplay]() {
+        XRecordProcessReplies(dataDisplay);
+    });
+    recordContexts_X11()->insert(nativeInput, recordContext);
+
+    XRecordProcessReplies(dataDisplay); // replies Xlib may already have read
+    return Qt::Native::Success;
+}
+
+Qt::Native::Status removeEventHandler_X11(QNativeInput *nativeInput)
+{
+    RecordContext_X11 *recordContext = recordContexts_X11()->take(nativeInput);
+    if (!recordContext)
+        return Qt::Native::Success;
+
+    Display *display = display_X11();
+    XRecordDisableContext(display, recordContext->context);
+    XRecordFreeContext(display, recordContext->context);
+    XFlush(display);
+    delete recordContext->notifier;
+    XCloseDisplay(recordContext->dataDisplay);
+    delete recordContext;
+    return Qt::Native::Success;
+}
+
+Qt::Native::Status sendNativeKeyEvent_X11(const QNativeKeyEvent &event)
+{
+    Display *display = display_X11();
+    if (!display)
+        return Qt::Native::Failure;
+
+    setModifiersFromQNativeEvent(display, event);
+    XTestFakeKeyEvent(display, event.nativeKeyCode, event.press, CurrentTime);
+    return flushUnlessBatching_X11(display);
+}
+
+Qt::Native::Status sendNativeMouseMoveEvent_X11(const QNativeMouseMoveEvent &event)
+{
+    Display *display = display_X11();
+    if (!display)
+        return Qt::Native::Failure;
+
+    setModifiersFromQNativeEvent(display, event);
+    XTestFakeMotionEvent(display, -1, event.globalPos.x(), event.globalPos.y(), CurrentTime);
+    return flushUnlessBatching_X11(display);
+}
+
+Qt::Native::Status sendNativeMouseButtonEvent_X11(const QNativeMouseButtonEvent &event)
+{
+    Display *display = display_X11();
+    if (!display)
+        return Qt::Native::Failure;
+
+    setModifiersFromQNativeEvent(display, event);
+    XTestFakeMotionEvent(display, -1, event.globalPos.x(), event.globalPos.y(), CurrentTime);
+    XTestFakeButtonEvent(display, getXButton(event.button), event.clickCount > 0, CurrentTime);
+    return flushUnlessBatching_X11(display);
+}
+
+Qt::Native::Status sendNativeMouseDragEvent_X11(const QNativeMouseDragEvent &event)
+{
+    // The button is held down since the preceding press; XTest tracks
+    // the button state, so a drag is a plain motion event.
+    Display *display = display_X11();
+    if (!display)
+        return Qt::Native::Failure;
+
+    setModifiersFromQNativeEvent(display, event);
+    XTestFakeMotionEvent(display, -1, event.globalPos.x(), event.globalPos.y(), CurrentTime);
+    return flushUnlessBatching_X11(display);
+}
+
+Qt::Native::Status sendNativeMouseWheelEvent_X11(const QNativeMouseWheelEvent &event)
+{
+    Display *display = display_X11();
+    if (!display)
+        return Qt::Native::Failure;
+
+    setModifiersFromQNativeEvent(display, event);
+    XTestFakeMotionEvent(display, -1, event.globalPos.x(), event.globalPos.y(), CurrentTime);
+
+    // One button 4 (up) or 5 (down) click per wheel step.
+    unsigned int button = event.delta > 0 ? Button4 : Button5;
+    for (int i = 0; i < qAbs(event.delta); ++i) {
+        XTestFakeButtonEvent(display, button, True, CurrentTime);
+        XTestFakeButtonEvent(display, button, False, CurrentTime);
+    }
+    return flushUnlessBatching_X11(display);
+}
+
+Qt::Native::Status sendNativeModifierEvent_X11(const QNativeModifierEvent &event)
+{
+    Display *display = display_X11();
+    if (!display)
+        return Qt::Native::Failure;
+
+    setModifiersFromQNativeEvent(display, event);
+    return flushUnlessBatching_X11(display);
+}
+
+//  ************************************************************
+//  QNativeInput methods:
+//  ************************************************************
+
+Qt::Native::Status QNativeInput::sendNativeMouseButtonEvent(const QNativeMouseButtonEvent &event)
+{
+    return sendNativeMouseButtonEvent_X11(event);
+}
+
+Qt::Native::Status QNativeInput::sendNativeMouseMoveEvent(const QNativeMouseMoveEvent &event)
+{
+    return sendNativeMouseMoveEvent_X11(event);
+}
+
+Qt::Native::Status QNativeInput::sendNativeMouseDragEvent(const QNativeMouseDragEvent &event)
+{
+    return sendNativeMouseDragEvent_X11(event);
+}
+
+Qt::Native::Status QNativeInput::sendNativeMouseWheelEvent(const QNativeMouseWheelEvent &event)
+{
+    return sendNativeMouseWheelEvent_X11(event);
+}
+
+Qt::Native::Status QNativeInput::sendNativeKeyEvent(const QNativeKeyEvent &event, int pid)
+{
+    // XTest injects into the server; events go to the focus window.
+    Q_UNUSED(pid);
+    return sendNativeKeyEvent_X11(event);
+}
+
+Qt::Native::Status QNativeInput::sendNativeModifierEvent(const QNativeModifierEvent &event)
+{
+    return sendNativeModifierEvent_X11(event);
+}
+
+void QNativeInput::flushNativeEvents()
+{
+    if (Display *display = display_X11())
+        XFlush(display);
+}
+
+Qt::Native::Status QNativeInput::subscribeForNativeEvents()
+{
+    return insertEventHandler_X11(this);
+}
+
+Qt::Native::Status QNativeInput::unsubscribeForNativeEvents()
+{
+    return removeEventHandler_X11(this);
+}
+
+// Some Qt to X11 mappings (evdev keycodes, as used by Xorg and Xvfb):
+int QNativeKeyEvent::Key_A = 38;
+int QNativeKeyEvent::Key_B = 56;
+int QNativeKeyEvent::Key_C = 54;
+int QNativeKeyEvent::Key_1 = 10;
+int QNativeKeyEvent::Key_Backspace = 22;
+int QNativeKeyEvent::Key_Enter = 36;
+int QNativeKeyEvent::Key_Del = 119;
@@ -0,0 +1,345 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qnativeeventstream.h"
+
+const char QNativeEventStream::Magic[4] = { 'Q', 'N', 'E', 'V' };
+
+static const int writerBufferSize = 64 * 1024;
+
+static inline quint64 zigzagEncode(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+static inline qint64 zigzagDecode(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+//  ************************************************************
+//  QNativeEventStreamWriter
+//  ************************************************************
+
+QNativeEventStreamWriter::QNativeEventStreamWriter(QIODevice *device)
+    : device(device)
+    , lastTimestamp(0)
+    , error(false)
+{
+    buffer.reserve(writerBufferSize);
+
+    uchar header[QNativeEventStream::HeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, QNativeEventStream::Magic, 4);
+    qToLittleEndian<quint16>(QNativeEventStream::Version, header + 4);
+    qToLittleEndian<quint16>(QNativeEventStream::HeaderSize, header + 6);
+    buffer.append(reinterpret_cast<const char *>(header), sizeof(header));
+}
+
+QNativeEventStreamWriter::~QNativeEventStreamWriter()
+{
+    flush();
+}
+
+void QNativeEventStreamWriter::putVarint(quint64 value)
+{
+    while (value >= 0x80) {
+        buffer.append(char(value | 0x80));
+        value >>= 7;
+    }
+    buffer.append(char(value));
+}
+
+void QNativeEventStreamWriter::putSigned(qint64 value)
+{
+    putVarint(zigzagEncode(value));
+}
+
+bool QNativeEventStreamWriter::write(const QNativeEvent &event, qint64 timestampNs)
+{
+    if (error)
+        return false;
+
+    // Timestamps are expected to be monotonic; clamp if they are not.
+    qint64 delta = qMax<qint64>(0, timestampNs - lastTimestamp);
+    lastTimestamp += delta;
+
+    int id = event.id();
+    switch (id) {
+        case QNativeMouseMoveEvent::eventId:
+        case QNativeMouseButtonEvent::eventId:
+        case QNativeMouseDragEvent::eventId:
+        case QNativeMouseWheelEvent::eventId:
+        case QNativeKeyEvent::eventId:
+        case QNativeModifierEvent::eventId:
+            break;
+        default:
+            qWarning() << "Warning: Cannot record a pure native event. Use a sub class.";
+            return false;
+    }
+
+    buffer.append(char(id));
+    putVarint(quint64(delta));
+    putVarint(quint64(int(event.modifiers)));
+
+    switch (id) {
+        case QNativeMouseMoveEvent::eventId:
+        case QNativeMouseButtonEvent::eventId:
+        case QNativeMouseDragEvent::eventId:
+        case QNativeMouseWheelEvent::eventId: {
+            const QNativeMouseEvent &e = static_cast<const QNativeMouseEvent &>(event);
+            putSigned(e.globalPos.x() - lastPos.x());
+            putSigned(e.globalPos.y() - lastPos.y());
+            lastPos = e.globalPos;
+            break; }
+        default:
+            break;
+    }
+
+    switch (id) {
+        case QNativeMouseButtonEvent::eventId:
+        case QNativeMouseDragEvent::eventId: {
+            const QNativeMouseButtonEvent &e = static_cast<const QNativeMouseButtonEvent &>(event);
+            putVarint(quint64(e.button));
+            putSigned(e.clickCount);
+            break; }
+        case QNativeMouseWheelEvent::eventId:
+            putSigned(static_cast<const QNativeMouseWheelEvent &>(event).delta);
+            break;
+        case QNativeKeyEvent::eventId: {
+            const QNativeKeyEvent &e = static_cast<const QNativeKeyEvent &>(event);
+            putVarint(quint64(e.nativeKeyCode));
+            buffer.append(char(e.press ? 1 : 0));
+            putVarint(e.character.unicode());
+            break; }
+        case QNativeModifierEvent::eventId:
+            putVarint(quint64(static_cast<const QNativeModifierEvent &>(event).nativeKeyCode));
+            break;
+        default:
+            break;
+    }
+
+    if (buffer.size() >= writerBufferSize)
+        return flush();
+    return true;
+}
+
+bool QNativeEventStreamWriter::flush()
+{
+    if (error || buffer.isEmpty())
+        return !error;
+    if (device->write(buffer) != buffer.size()) {
+        qWarning() << "QNativeEventStreamWriter: write failed:" << device->errorString();
+        error = true;
+    }
+    buffer.resize(0); // keeps the allocation
+    return !error;
+}
+
+//  ************************************************************
+//  QNativeEventStreamReader
+//  ************************************************************
+
+QNativeEventStreamReader::QNativeEventStreamReader(const QString &fileName)
+    : file(fileName)
+    , begin(0)
+    , pos(0)
+    , end(0)
+    , streamVersion(0)
+    , valid(false)
+    , error(false)
+    , lastTimestamp(0)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "QNativeEventStreamReader: could not open" << fileName << file.errorString();
+        return;
+    }
+
+    // Map the entire file. Fall back to reading it if the file
+    // can't be mapped (sequential devices, some file systems).
+    begin = file.map(0, file.size());
+    if (!begin) {
+        data = file.readAll();
+        begin = reinterpret_cast<const uchar *>(data.constData());
+    }
+    end = begin + (data.isEmpty() ? file.size() : data.size());
+    readHeader();
+}
+
+QNativeEventStreamReader::QNativeEventStreamReader(const QByteArray &data)
+    : data(data)
+    , begin(reinterpret_cast<const uchar *>(this->data.constData()))
+    , pos(0)
+    , end(begin + this->data.size())
+    , streamVersion(0)
+    , valid(false)
+    , error(false)
+    , lastTimestamp(0)
+{
+    readHeader();
+}
+
+QNativeEventStreamReader::~QNativeEventStreamReader()
+{
+    if (file.isOpen() && data.isEmpty() && begin)
+        file.unmap(const_cast<uchar *>(begin));
+}
+
+void QNativeEventStreamReader::readHeader()
+{
+    pos = end;
+    if (end - begin < QNativeEventStream::HeaderSize
+        || memcmp(begin, QNativeEventStream::Magic, 4) != 0) {
+        qWarning() << "QNativeEventStreamReader: not a native event stream";
+        return;
+    }
+
+    streamVersion = qFromLittleEndian<quint16>(begin + 4);
+    int headerSize = qFromLittleEndian<quint16>(begin + 6);
+    if (streamVersion == 0 || streamVersion > QNativeEventStream::Version
+        || headerSize < QNativeEventStream::HeaderSize
+        || headerSize > end - begin) {
+        qWarning() << "QNativeEventStreamReader: unsupported stream version" << streamVersion;
+        return;
+    }
+
+    pos = begin + headerSize;
+    valid = true;
+}
+
+bool QNativeEventStreamReader::getVarint(quint64 *value)
+{
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        uchar byte = *pos++;
+        result |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    error = true;
+    return false;
+}
+
+bool QNativeEventStreamReader::getSigned(qint64 *value)
+{
+    quint64 encoded;
+    if (!getVarint(&encoded))
+        return false;
+    *value = zigzagDecode(encoded);
+    return true;
+}
+
+bool QNativeEventStreamReader::getInt(int *value)
+{
+    quint64 v;
+    if (!getVarint(&v))
+        return false;
+    *value = int(v);
+    return true;
+}
+
+bool QNativeEventStreamReader::getPos(QPoint *value)
+{
+    qint64 dx, dy;
+    if (!getSigned(&dx) || !getSigned(&dy))
+        return false;
+    lastPos += QPoint(int(dx), int(dy));
+    *value = lastPos;
+    return true;
+}
+
+const QNativeEvent *QNativeEventStreamReader::readNext(qint64 *timestampNs)
+{
+    if (!valid || error || pos >= end)
+        return 0;
+
+    int id = *pos++;
+    quint64 delta;
+    int modifiers;
+    if (!getVarint(&delta) || !getInt(&modifiers))
+        return 0;
+    lastTimestamp += qint64(delta);
+    if (timestampNs)
+        *timestampNs = lastTimestamp;
+
+    QNativeEvent *event = 0;
+    bool ok = false;
+    switch (id) {
+        case QNativeMouseMoveEvent::eventId:
+            ok = getPos(&mouseMoveEvent.globalPos);
+            event = &mouseMoveEvent;
+            break;
+        case QNativeMouseButtonEvent::eventId:
+        case QNativeMouseDragEvent::eventId: {
+            QNativeMouseButtonEvent *e = (id == QNativeMouseButtonEvent::eventId) ? &mouseButtonEvent : &mouseDragEvent;
+            int button;
+            qint64 clickCount;
+            ok = getPos(&e->globalPos) && getInt(&button) && getSigned(&clickCount);
+            e->button = Qt::MouseButton(button);
+            e->clickCount = int(clickCount);
+            event = e;
+            break; }
+        case QNativeMouseWheelEvent::eventId: {
+            qint64 wheelDelta;
+            ok = getPos(&mouseWheelEvent.globalPos) && getSigned(&wheelDelta);
+            mouseWheelEvent.delta = int(wheelDelta);
+            event = &mouseWheelEvent;
+            break; }
+        case QNativeKeyEvent::eventId: {
+            int character;
+            ok = getInt(&keyEvent.nativeKeyCode) && pos < end;
+            if (ok)
+                keyEvent.press = *pos++;
+            ok = ok && getInt(&character);
+            keyEvent.character = QChar(ushort(character));
+            event = &keyEvent;
+            break; }
+        case QNativeModifierEvent::eventId:
+            ok = getInt(&modifierEvent.nativeKeyCode);
+            event = &modifierEvent;
+            break;
+        default:
+            qWarning() << "QNativeEventStreamReader: unknown event tag" << id;
+            break;
+    }
+
+    if (!ok) {
+        error = true;
+        return 0;
+    }
+
+    event->modifiers = Qt::KeyboardModifiers(modifiers);
+    return event;
+}
@@ -0,0 +1,138 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q_NATIVE_EVENT_STREAM
+#define Q_NATIVE_EVENT_STREAM
+
+#include <QtCore>
+#include "qnativeevents.h"
+
+// ----------------------------------------------------------------------------
+// Compact binary recording format for QNativeEvent streams.
+//
+// A stream is a fixed 16-byte header followed by a sequence of variable
+// length records. All multi-byte header fields are little-endian:
+//
+//   quint8[4]  magic      "QNEV"
+//   quint16    version    QNativeEventStream::Version
+//   quint16    headerSize 16 for version 1
+//   quint32    flags      reserved, 0
+//   quint32    reserved   0
+//
+// Each record starts with a one-byte type tag, which is the eventId of the
+// recorded event class, followed by the timestamp as an unsigned varint delta
+// (in nanoseconds) from the previous record and the modifiers as an unsigned
+// varint. Mouse positions are stored as zigzag varint deltas from the previous
+// mouse position in the stream. The remaining per-type fields are:
+//
+//   QNativeMouseMoveEvent      dx dy
+//   QNativeMouseButtonEvent    dx dy button clickCount
+//   QNativeMouseDragEvent      dx dy button clickCount
+//   QNativeMouseWheelEvent     dx dy delta
+//   QNativeKeyEvent            nativeKeyCode press character
+//   QNativeModifierEvent       nativeKeyCode
+// ----------------------------------------------------------------------------
+
+namespace QNativeEventStream {
+    enum { Version = 1, HeaderSize = 16 };
+    extern const char Magic[4];
+}
+
+class QNativeEventStreamWriter
+{
+public:
+    QNativeEventStreamWriter(QIODevice *device);
+    ~QNativeEventStreamWriter();
+
+    bool write(const QNativeEvent &event, qint64 timestampNs = 0);
+    bool flush();
+    bool hasError() const { return error; }
+
+private:
+    Q_DISABLE_COPY(QNativeEventStreamWriter)
+    void putVarint(quint64 value);
+    void putSigned(qint64 value);
+
+    QIODevice *device;
+    QByteArray buffer;
+    qint64 lastTimestamp;
+    QPoint lastPos;
+    bool error;
+};
+
+// Reads a stream from a memory mapped file (or an in-memory byte array).
+// readNext() decodes into per-type event instances owned by the reader,
+// which means that iterating a recording does not allocate. The returned
+// event is valid until the next call to readNext().
+class QNativeEventStreamReader
+{
+public:
+    QNativeEventStreamReader(const QString &fileName);
+    QNativeEventStreamReader(const QByteArray &data);
+    ~QNativeEventStreamReader();
+
+    bool isValid() const { return valid; }
+    bool hasError() const { return error; }
+    bool atEnd() const { return pos >= end; }
+    int version() const { return streamVersion; }
+
+    const QNativeEvent *readNext(qint64 *timestampNs = 0);
+
+private:
+    Q_DISABLE_COPY(QNativeEventStreamReader)
+    void readHeader();
+    bool getVarint(quint64 *value);
+    bool getSigned(qint64 *value);
+    bool getInt(int *value);
+    bool getPos(QPoint *pos);
+
+    QFile file;
+    QByteArray data;
+    const uchar *begin;
+    const uchar *pos;
+    const uchar *end;
+    int streamVersion;
+    bool valid;
+    bool error;
+    qint64 lastTimestamp;
+    QPoint lastPos;
+
+    QNativeMouseMoveEvent mouseMoveEvent;
+    QNativeMouseButtonEvent mouseButtonEvent;
+    QNativeMouseDragEvent mouseDragEvent;
+    QNativeMouseWheelEvent mouseWheelEvent;
+    QNativeKeyEvent keyEvent;
+    QNativeModifierEvent modifierEvent;
+};
+
+#endif // Q_NATIVE_EVENT_STREAM
@@ -0,0 +1,235 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q_NATIVE_EVENT_VARIANT
+#define Q_NATIVE_EVENT_VARIANT
+
+#include <QtCore>
+#include <new>
+#include <utility>
+#include "qnativeevents.h"
+
+// ----------------------------------------------------------------------------
+// QNativeEventVariant is a closed, value-type alternative to passing
+// QNativeEvent pointers around. It holds exactly one of the concrete event
+// classes, tagged with its eventId. visit() switches on the tag and calls
+// the visitor with the concrete type, which is resolved at compile time:
+// there are no virtual calls or downcasts on the dispatch path.
+//
+//    struct Printer {
+//        void operator()(const QNativeMouseMoveEvent &e) { ... }
+//        void operator()(const QNativeKeyEvent &e) { ... }
+//        template <typename T> void operator()(const T &) { }  // the rest
+//    };
+//    variant.visit(Printer());
+// ----------------------------------------------------------------------------
+
+class QNativeEventVariant
+{
+public:
+    QNativeEventVariant() : m_type(0) {}
+    QNativeEventVariant(const QNativeMouseMoveEvent &e) { construct(e); }
+    QNativeEventVariant(const QNativeMouseButtonEvent &e) { construct(e); }
+    QNativeEventVariant(const QNativeMouseDragEvent &e) { construct(e); }
+    QNativeEventVariant(const QNativeMouseWheelEvent &e) { construct(e); }
+    QNativeEventVariant(const QNativeKeyEvent &e) { construct(e); }
+    QNativeEventVariant(const QNativeModifierEvent &e) { construct(e); }
+    QNativeEventVariant(const QNativeEventVariant &other) : m_type(0)
+    {
+        if (other.isValid())
+            other.visit(Assigner(this));
+    }
+    ~QNativeEventVariant() { reset(); }
+
+    QNativeEventVariant &operator=(const QNativeEventVariant &other)
+    {
+        if (this != &other) {
+            reset();
+            if (other.isValid())
+                other.visit(Assigner(this));
+        }
+        return *this;
+    }
+
+    // Converts from the polymorphic representation. This is the one place
+    // that needs to look at QNativeEvent::id().
+    static QNativeEventVariant fromEvent(const QNativeEvent &event)
+    {
+        switch (event.id()) {
+            case QNativeMouseMoveEvent::eventId:
+                return QNativeEventVariant(static_cast<const QNativeMouseMoveEvent &>(event));
+            case QNativeMouseButtonEvent::eventId:
+                return QNativeEventVariant(static_cast<const QNativeMouseButtonEvent &>(event));
+            case QNativeMouseDragEvent::eventId:
+                return QNativeEventVariant(static_cast<const QNativeMouseDragEvent &>(event));
+            case QNativeMouseWheelEvent::eventId:
+                return QNativeEventVariant(static_cast<const QNativeMouseWheelEvent &>(event));
+            case QNativeKeyEvent::eventId:
+                return QNativeEventVariant(static_cast<const QNativeKeyEvent &>(event));
+            case QNativeModifierEvent::eventId:
+                return QNativeEventVariant(static_cast<const QNativeModifierEvent &>(event));
+            default:
+                return QNativeEventVariant();
+        }
+    }
+
+    bool isValid() const { return m_type != 0; }
+    int type() const { return m_type; } // the eventId of the held event, or 0
+
+    // Returns the held event as a QNativeEvent, for use with the existing
+    // polymorphic API (sendNativeEvent(), operator<<).
+    const QNativeEvent *event() const
+    {
+        return m_type ? reinterpret_cast<const QNativeEvent *>(visit(Address())) : 0;
+    }
+
+    // Calls visitor with the held event. Visiting an invalid variant warns and
+    // returns a default-constructed result; visitors return by value or void.
+    template <typename Visitor>
+    auto visit(Visitor &&visitor) const
+        -> decltype(visitor(std::declval<const QNativeMouseMoveEvent &>()))
+    {
+        typedef decltype(visitor(std::declval<const QNativeMouseMoveEvent &>())) Result;
+        switch (m_type) {
+            case QNativeMouseMoveEvent::eventId: return visitor(m_storage.mouseMove);
+            case QNativeMouseButtonEvent::eventId: return visitor(m_storage.mouseButton);
+            case QNativeMouseDragEvent::eventId: return visitor(m_storage.mouseDrag);
+            case QNativeMouseWheelEvent::eventId: return visitor(m_storage.mouseWheel);
+            case QNativeKeyEvent::eventId: return visitor(m_storage.key);
+            case QNativeModifierEvent::eventId: return visitor(m_storage.modifier);
+            default: // an invalid variant: the visitor is not called
+                qWarning() << "QNativeEventVariant: cannot visit event type" << m_type;
+                return Result();
+        }
+    }
+
+private:
+    struct Assigner
+    {
+        Assigner(QNativeEventVariant *target) : target(target) {}
+        template <typename T> void operator()(const T &e) const { target->construct(e); }
+        QNativeEventVariant *target;
+    };
+
+    struct Address
+    {
+        template <typename T> const void *operator()(const T &e) const { return static_cast<const QNativeEvent *>(&e); }
+    };
+
+    struct Destroyer
+    {
+        template <typename T> void operator()(const T &e) const { e.~T(); }
+    };
+
+    template <typename T>
+    void construct(const T &e)
+    {
+        new (&m_storage) T(e);
+        m_type = T::eventId;
+    }
+
+    void reset()
+    {
+        if (m_type)
+            visit(Destroyer());
+        m_type = 0;
+    }
+
+    union Storage {
+        Storage() {}
+        ~Storage() {}
+        QNativeMouseMoveEvent mouseMove;
+        QNativeMouseButtonEvent mouseButton;
+        QNativeMouseDragEvent mouseDrag;
+        QNativeMouseWheelEvent mouseWheel;
+        QNativeKeyEvent key;
+        QNativeModifierEvent modifier;
+    } m_storage;
+    int m_type;
+};
+
+// ----------------------------------------------------------------------------
+// Statically bound counterparts to QNativeInput::nativeEvent() and
+// QNativeInput::sendNativeEvent(). The handler is any class with (non-virtual)
+// nativeMousePressEvent(), nativeMouseReleaseEvent(), nativeMouseMoveEvent(),
+// nativeMouseDragEvent(), nativeMouseWheelEvent(), nativeKeyPressEvent(),
+// nativeKeyReleaseEvent() and nativeModifierEvent() functions taking const
+// references to the corresponding event classes.
+// ----------------------------------------------------------------------------
+
+template <typename Handler>
+struct QNativeEventDispatcher
+{
+    QNativeEventDispatcher(Handler &handler) : handler(handler) {}
+
+    void operator()(const QNativeMouseButtonEvent &e) const
+    { (e.clickCount > 0) ? handler.nativeMousePressEvent(e) : handler.nativeMouseReleaseEvent(e); }
+    void operator()(const QNativeMouseMoveEvent &e) const { handler.nativeMouseMoveEvent(e); }
+    void operator()(const QNativeMouseDragEvent &e) const { handler.nativeMouseDragEvent(e); }
+    void operator()(const QNativeMouseWheelEvent &e) const { handler.nativeMouseWheelEvent(e); }
+    void operator()(const QNativeKeyEvent &e) const
+    { e.press ? handler.nativeKeyPressEvent(e) : handler.nativeKeyReleaseEvent(e); }
+    void operator()(const QNativeModifierEvent &e) const { handler.nativeModifierEvent(e); }
+
+    Handler &handler;
+};
+
+template <typename Handler>
+inline void qDispatchNativeEvent(const QNativeEventVariant &event, Handler &handler)
+{
+    if (event.isValid())
+        event.visit(QNativeEventDispatcher<Handler>(handler));
+}
+
+struct QNativeEventSender
+{
+    QNativeEventSender(int pid = 0) : pid(pid) {}
+
+    Qt::Native::Status operator()(const QNativeMouseMoveEvent &e) const { return QNativeInput::sendNativeMouseMoveEvent(e); }
+    Qt::Native::Status operator()(const QNativeMouseButtonEvent &e) const { return QNativeInput::sendNativeMouseButtonEvent(e); }
+    Qt::Native::Status operator()(const QNativeMouseDragEvent &e) const { return QNativeInput::sendNativeMouseDragEvent(e); }
+    Qt::Native::Status operator()(const QNativeMouseWheelEvent &e) const { return QNativeInput::sendNativeMouseWheelEvent(e); }
+    Qt::Native::Status operator()(const QNativeKeyEvent &e) const { return QNativeInput::sendNativeKeyEvent(e, pid); }
+    Qt::Native::Status operator()(const QNativeModifierEvent &e) const { return QNativeInput::sendNativeModifierEvent(e); }
+
+    int pid;
+};
+
+inline Qt::Native::Status qSendNativeEvent(const QNativeEventVariant &event, int pid = 0)
+{
+    if (!event.isValid())
+        return Qt::Native::Failure;
+    return event.visit(QNativeEventSender(pid));
+}
+
+#endif // Q_NATIVE_EVENT_VARIANT
@@ -0,0 +1,427 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtCore>
+
+// ----------------------------------------------------------------------------
+// Runs the test functions and data rows of a QtTest executable (for example
+// tst_qcocoawindow) in parallel worker processes, and merges the results
+// into one report with per-row timing.
+//
+//   shardrunner [-j N] [--xvfb] [--platform name] [--timeout s] [--output file]
+//               <test executable> [test function ...]
+//
+// The work items are "function:datatag" pairs as listed by -datatags; the
+// global data rows (initTestCase_data) run within each item. Each of the N
+// worker slots runs one item at a time. With --xvfb each slot gets a private
+// Xvfb server, which isolates the windows of concurrent workers. On macOS
+// the workers share the window server, so tests that depend on window
+// stacking or focus may interfere.
+// ----------------------------------------------------------------------------
+
+struct WorkItem
+{
+    QString function;
+    QString dataTag; // empty for functions without local data
+    bool passed;
+    bool timedOut;
+    qint64 elapsedMs;
+    QByteArray output;
+
+    QString name() const { return dataTag.isEmpty() ? function : function + QLatin1Char(':') + dataTag; }
+};
+
+class ShardRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    ShardRunner(const QString &testExecutable, const QStringList &functions);
+    ~ShardRunner();
+
+    void setWorkerCount(int count) { workerCount = qMax(1, count); }
+    void setUseXvfb(bool enable) { useXvfb = enable; }
+    void setPlatform(const QString &name) { platform = name; }
+    void setTimeout(int seconds) { timeoutMs = seconds * 1000; }
+
+    bool listWorkItems();
+    void run();
+    QString report() const;
+    bool allPassed() const;
+
+private slots:
+    void workerFinished(int slot);
+    void workerError(int slot, QProcess::ProcessError error);
+    void workerTimedOut(int slot);
+
+private:
+    struct Worker
+    {
+        QProcess *process;
+        QProcess *xvfb;
+        int display; // Xvfb display number
+        QTimer *timer;
+        QElapsedTimer clock;
+        int item;
+    };
+
+    bool startXvfb(int slot);
+    void startNext(int slot);
+    void completeItem(int slot);
+    QProcessEnvironment environment(int slot) const;
+
+    QString testExecutable;
+    QStringList functions;
+    QVector<WorkItem> items;
+    QVector<Worker> workers;
+    int nextItem;
+    int running;
+    int workerCount;
+    bool useXvfb;
+    QString platform;
+    int timeoutMs;
+    QElapsedTimer wallClock;
+    qint64 wallMs;
+};
+
+ShardRunner::ShardRunner(const QString &testExecutable, const QStringList &functions)
+    : testExecutable(testExecutable)
+    , functions(functions)
+    , nextItem(0)
+    , running(0)
+    , workerCount(QThread::idealThreadCount())
+    , useXvfb(false)
+    , timeoutMs(300 * 1000)
+    , wallMs(0)
+{
+}
+
+ShardRunner::~ShardRunner()
+{
+    foreach (const Worker &worker, workers) {
+        if (worker.xvfb) {
+            worker.xvfb->terminate();
+            worker.xvfb->waitForFinished();
+        }
+    }
+}
+
+// Asks the test for its functions and data tags. -datatags prints one line
+// per row: "<testname> <function> [<datatag>] [__global__ <globaltag>]".
+// Data tags may contain spaces, so only the first two fields are split off.
+bool ShardRunner::listWorkItems()
+{
+    QProcess lister;
+    lister.start(testExecutable, QStringList() << "-datatags");
+    if (!lister.waitForFinished(60 * 1000) || lister.exitStatus() != QProcess::NormalExit) {
+        qWarning() << "shardrunner: could not list the data tags of" << testExecutable;
+        return false;
+    }
+
+    QSet<QString> seen;
+    const QString globalMarker = QStringLiteral("__global__ ");
+    foreach (const QByteArray &line, lister.readAllStandardOutput().split('\n')) {
+        QString text = QString::fromLocal8Bit(line);
+        if (text.endsWith(QLatin1Char('\r')))
+            text.chop(1);
+        int functionStart = text.indexOf(QLatin1Char(' ')) + 1;
+        if (functionStart <= 0)
+            continue;
+        int functionEnd = text.indexOf(QLatin1Char(' '), functionStart);
+        WorkItem item;
+        item.function = text.mid(functionStart, functionEnd < 0 ? -1 : functionEnd - functionStart);
+        if (item.function.isEmpty())
+            continue;
+        if (functionEnd >= 0) {
+            // The rest is "<datatag>", "<datatag> __global__ <globaltag>"
+            // or "__global__ <globaltag>"; global rows run within each item.
+            QString rest = text.mid(functionEnd + 1);
+            if (rest.startsWith(globalMarker))
+                rest.clear();
+            int global = rest.indexOf(QLatin1Char(' ') + globalMarker);
+            if (global >= 0)
+                rest.truncate(global);
+            item.dataTag = rest;
+        }
+        item.passed = false;
+        item.timedOut = false;
+        item.elapsedMs = 0;
+
+        if (item.function == QLatin1String("initTestCase") || item.function == QLatin1String("cleanupTestCase"))
+            continue;
+        if (!functions.isEmpty() && !functions.contains(item.function))
+            continue;
+        if (seen.contains(item.name()))
+            continue; // one item per local row, covering all global rows
+        seen.insert(item.name());
+        items.append(item);
+    }
+    return true;
+}
+
+// Xvfb picks a free display number and writes it to -displayfd (here its
+// stdout) once it accepts connections, so concurrent runners and existing
+// displays don't collide, and no fixed startup delay is needed.
+bool ShardRunner::startXvfb(int slot)
+{
+    QProcess *xvfb = new QProcess(this);
+    xvfb->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    xvfb->start("Xvfb", QStringList() << "-displayfd" << "1"
+                                      << "-screen" << "0" << "1920x1200x24" << "-nolisten" << "tcp");
+    if (!xvfb->waitForStarted()) {
+        qWarning() << "shardrunner: could not start Xvfb" << xvfb->errorString();
+        delete xvfb;
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!xvfb->canReadLine() && xvfb->state() == QProcess::Running && timer.elapsed() < 10000)
+        xvfb->waitForReadyRead(10000 - int(timer.elapsed()));
+    bool ok = false;
+    int display = xvfb->canReadLine() ? xvfb->readLine().trimmed().toInt(&ok) : -1;
+    if (!ok) {
+        qWarning() << "shardrunner: Xvfb did not report a display";
+        xvfb->kill();
+        xvfb->waitForFinished();
+        delete xvfb;
+        return false;
+    }
+
+    workers[slot].xvfb = xvfb;
+    workers[slot].display = display;
+    return true;
+}
+
+QProcessEnvironment ShardRunner::environment(int slot) const
+{
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    // Without a running Xvfb (it failed to start) the inherited display is used.
+    if (workers.at(slot).xvfb) {
+        env.insert("DISPLAY", QString(":%1").arg(workers.at(slot).display));
+        env.insert("QT_QPA_PLATFORM", "xcb");
+    }
+    if (!platform.isEmpty())
+        env.insert("QT_QPA_PLATFORM", platform);
+    return env;
+}
+
+void ShardRunner::run()
+{
+    wallClock.start();
+    workers.resize(qMin(workerCount, items.size()));
+    for (int slot = 0; slot < workers.size(); ++slot) {
+        Worker &worker = workers[slot];
+        worker.xvfb = 0;
+        worker.display = -1;
+        worker.item = -1;
+        if (useXvfb && !startXvfb(slot))
+            qWarning() << "shardrunner: worker" << slot << "runs without Xvfb";
+
+        worker.process = new QProcess(this);
+        worker.process->setProcessChannelMode(QProcess::MergedChannels);
+        worker.process->setProcessEnvironment(environment(slot));
+        connect(worker.process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                this, [this, slot]() { workerFinished(slot); });
+        connect(worker.process, &QProcess::errorOccurred,
+                this, [this, slot](QProcess::ProcessError error) { workerError(slot, error); });
+
+        worker.timer = new QTimer(this);
+        worker.timer->setSingleShot(true);
+        connect(worker.timer, &QTimer::timeout, this, [this, slot]() { workerTimedOut(slot); });
+    }
+
+    for (int slot = 0; slot < workers.size(); ++slot)
+        startNext(slot);
+
+    while (running > 0)
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    wallMs = wallClock.elapsed();
+}
+
+void ShardRunner::startNext(int slot)
+{
+    Worker &worker = workers[slot];
+    if (nextItem >= items.size()) {
+        worker.item = -1;
+        return;
+    }
+
+    worker.item = nextItem++;
+    ++running;
+    const WorkItem &item = items.at(worker.item);
+    worker.clock.start();
+    worker.timer->start(timeoutMs);
+    worker.process->start(testExecutable, QStringList() << item.name());
+}
+
+void ShardRunner::workerFinished(int slot)
+{
+    Worker &worker = workers[slot];
+    if (worker.item < 0)
+        return;
+
+    WorkItem &item = items[worker.item];
+    item.output = worker.process->readAll();
+    item.passed = !item.timedOut && worker.process->exitStatus() == QProcess::NormalExit
+        && worker.process->exitCode() == 0;
+    completeItem(slot);
+}
+
+// finished() is not emitted for a worker that could not be started; fail
+// the item and go on. Other errors are followed by finished().
+void ShardRunner::workerError(int slot, QProcess::ProcessError error)
+{
+    Worker &worker = workers[slot];
+    if (worker.item < 0 || error != QProcess::FailedToStart)
+        return;
+
+    WorkItem &item = items[worker.item];
+    item.output = "shardrunner: could not start the worker: "
+        + worker.process->errorString().toLocal8Bit() + '\n';
+    item.passed = false;
+    completeItem(slot);
+}
+
+void ShardRunner::completeItem(int slot)
+{
+    Worker &worker = workers[slot];
+    worker.timer->stop();
+    WorkItem &item = items[worker.item];
+    item.elapsedMs = worker.clock.elapsed();
+
+    fprintf(stdout, "%-4s %-60s %7lld ms\n", item.passed ? "PASS" : "FAIL",
+            qPrintable(item.name()), item.elapsedMs);
+    fflush(stdout);
+
+    --running;
+    startNext(slot);
+}
+
+void ShardRunner::workerTimedOut(int slot)
+{
+    Worker &worker = workers[slot];
+    if (worker.item < 0)
+        return;
+    items[worker.item].timedOut = true;
+    worker.process->kill(); // finished() follows
+}
+
+bool ShardRunner::allPassed() const
+{
+    foreach (const WorkItem &item, items) {
+        if (!item.passed)
+            return false;
+    }
+    return true;
+}
+
+QString ShardRunner::report() const
+{
+    QString report;
+    QTextStream s(&report);
+
+    int passed = 0;
+    qint64 serialMs = 0;
+    foreach (const WorkItem &item, items) {
+        passed += item.passed ? 1 : 0;
+        serialMs += item.elapsedMs;
+    }
+
+    s << "Results for " << testExecutable << ", " << workers.size() << " workers\n";
+    foreach (const WorkItem &item, items) {
+        s << (item.passed ? "PASS  " : item.timedOut ? "TIME  " : "FAIL  ")
+          << item.name().leftJustified(60) << " " << item.elapsedMs << " ms\n";
+    }
+    s << "Totals: " << passed << " passed, " << items.size() - passed << " failed, "
+      << "wall time " << wallMs << " ms, serial time " << serialMs << " ms\n";
+
+    // Full output of the failed items.
+    foreach (const WorkItem &item, items) {
+        if (item.passed)
+            continue;
+        s << "\n========= " << item.name() << (item.timedOut ? " (timed out)" : "") << " =========\n";
+        s << QString::fromLocal8Bit(item.output);
+    }
+    s.flush();
+    return report;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs a QtTest executable sharded over parallel worker processes.");
+    parser.addHelpOption();
+    QCommandLineOption jobs(QStringList() << "j" << "jobs", "Number of worker processes.", "N",
+                            QString::number(QThread::idealThreadCount()));
+    QCommandLineOption xvfb("xvfb", "Run each worker on a private Xvfb display.");
+    QCommandLineOption platform("platform", "QPA platform for the workers, e.g. offscreen.", "name");
+    QCommandLineOption timeout("timeout", "Per-item timeout in seconds.", "s", "300");
+    QCommandLineOption output("output", "Write the merged report to file.", "file");
+    parser.addOption(jobs);
+    parser.addOption(xvfb);
+    parser.addOption(platform);
+    parser.addOption(timeout);
+    parser.addOption(output);
+    parser.addPositionalArgument("test", "The test executable.");
+    parser.addPositionalArgument("functions", "Test functions to run (default: all).", "[function...]");
+    parser.process(app);
+
+    QStringList args = parser.positionalArguments();
+    if (args.isEmpty())
+        parser.showHelp(1);
+
+    ShardRunner runner(args.takeFirst(), args);
+    runner.setWorkerCount(parser.value(jobs).toInt());
+    runner.setUseXvfb(parser.isSet(xvfb));
+    runner.setPlatform(parser.value(platform));
+    runner.setTimeout(parser.value(timeout).toInt());
+    if (!runner.listWorkItems())
+        return 2;
+    runner.run();
+
+    QString report = runner.report();
+    if (parser.isSet(output)) {
+        QFile file(parser.value(output));
+        if (file.open(QIODevice::WriteOnly | QIODevice::Text))
+            file.write(report.toLocal8Bit());
+        else
+            qWarning() << "shardrunner: cannot write" << file.fileName();
+    }
+    fprintf(stdout, "\n%s", qPrintable(report));
+    return runner.allPassed() ? 0 : 1;
+}
+
+#include "main.moc"
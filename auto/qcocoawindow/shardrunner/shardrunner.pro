@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = shardrunner
+
+QT = core
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+SOURCES += main.cpp
@@ -8,6 +8,9 @@
 #include <QtPlatformHeaders/QCocoaWindowFunctions>
 #endif
 #include <qpa/qplatformnativeinterface.h>
+#include <qnativeevents.h>
+#include <glcontent.h>
+#include <workload.h>
 
 // Public window class that abstracts window types and manages window instances,
 // with an API similar to QWindow.
@@ -25,6 +28,7 @@
 //   - Provide a common event counting API and implementation
 //
 class TestWindowImplBase;
+class TestWindowTrace;
 class TestWindow
 {
 public:
@@ -43,6 +47,20 @@ public:
     
     static void resetWindowCounter();
     static int windowCount();
+
+    // Window pool: deleted TestWindows are hidden and kept for reuse by
+    // createWindow() with the same configuration, after being reset to the
+    // default state. Reparented windows are not pooled. Disabling the pool
+    // deletes the pooled windows. Enabled by TESTWINDOWPOOL=1.
+    static void setPoolEnabled(bool enable);
+    static bool isPoolEnabled();
+    static void drainPool();
+
+    // Leak accounting. Unlike windowCount(), liveWindowCount() is never reset.
+    // Pooled windows are not counted. estimatedLiveWindowBytes() is the
+    // approximate size of the backing stores and framebuffers of live windows.
+    static int liveWindowCount();
+    static qint64 estimatedLiveWindowBytes();
     
     TestWindow(QPaintDeviceWindow *_d, TestWindowImplBase *_dbase);
     ~TestWindow();
@@ -72,9 +90,40 @@ public:
     // the event counter.
     bool takeOneEvent(EventType type);
     bool takeOneOrManyEvents(EventType type);
+    // Timestamped record of the events counted above, in arrival order.
+    const TestWindowTrace &trace() const;
+
+    // Condition-based waiting: spin the event loop until the condition holds
+    // or the timeout expires, and return whether it holds. Use instead of
+    // fixed WAITs. waitForEvent() waits until eventCount(type) >= count;
+    // waitForGeometry() until the QWindow and the native window and view
+    // all have the given screen geometry.
+    bool waitForEvent(EventType type, int count = 1, int timeoutMs = 5000);
+    bool waitForGeometry(QRect geometry, int timeoutMs = 5000);
+    // Statistics for the waits above: count, total and longest wait time.
+    static QString waitReport();
     
     void setFillColor(QColor color);
     void setForwardEvents(bool forward);
+    // Animate: schedule the next frame from every paint. Raster windows call
+    // update(), since QRasterWindow ignores a requestUpdate() with nothing
+    // dirty; OpenGL windows call requestUpdate().
+    void setContinuousUpdate(bool enable);
+    // OpenGL windows: draw triangleCount triangles with the core profile
+    // GLContentRenderer instead of clearing to the fill color, 0 disables.
+    // Call before show(); the window then gets a core profile format and
+    // is not pooled. Raster windows ignore this.
+    void setGLContent(int triangleCount);
+    // Paint a Workload on top of the fill color (or GL content) in every
+    // frame. Pass empty parameters to disable.
+    void setWorkload(const WorkloadParameters &parameters);
+
+    // Grabs the window content in-process, at 1x resolution: from the
+    // backing store for raster windows and from the framebuffer for OpenGL
+    // windows.
+    // Unlike grabWindow() this does not go through the window server, and
+    // works on any platform. Returns a null image before the first paint.
+    QImage grabContent();
 
     // Replicate and forward QWindow API
     void show() { dwin->show(); }
@@ -87,7 +136,7 @@ public:
     void setMask(QRect mask) { dwin->setMask(mask); }
     void raise() { dwin->raise(); }
     void create() { dwin->create(); }
-    void setParent(TestWindow *parent) { dwin->setParent(parent->qwindow()); }
+    void setParent(TestWindow *parent);
     QPlatformWindow *handle() { return dwin->handle(); }
     void setGeometry(int x, int y, int w, int h) { dwin->setGeometry(x, y, w, h); }
     void setGeometry(QRect geometry) { dwin->setGeometry(geometry); }
@@ -104,6 +153,49 @@ private:
 };
 Q_DECLARE_METATYPE(TestWindow::WindowConfiguration);
 
+// One handler call recorded by TestWindowTrace.
+struct TestWindowTraceEvent
+{
+    TestWindow::EventType type;
+    qint64 timestampNs; // QNativeInput::monotonicNs()
+    int exposeArea;     // expose events: area of the exposed region, in pixels
+    QRect paintRect;    // paint events: bounding rect of the painted region,
+                        // null for OpenGL windows which always repaint fully
+    QSize framebufferSize; // OpenGL paint events: size() * devicePixelRatio()
+                           // at paint time, invalid for raster windows
+};
+
+// Per-window event trace. Events are stored in a fixed-size ring which is
+// part of the window, which means that recording never allocates. When
+// the ring is full the oldest events are overwritten.
+class TestWindowTrace
+{
+public:
+    enum { Capacity = 1024 };
+
+    TestWindowTrace();
+    void clear();
+    void record(TestWindow::EventType type, int exposeArea = 0, QRect paintRect = QRect(),
+                QSize framebufferSize = QSize());
+
+    int count() const { return size; }
+    const TestWindowTraceEvent &at(int index) const { return events[(first + index) % Capacity]; }
+
+    // Index of the first event of the given type at or after from, or -1.
+    int indexOf(TestWindow::EventType type, int from = 0) const;
+    int eventCount(TestWindow::EventType type) const;
+    // Time from the first event of type from to the first following event
+    // of type to, for example expose-to-first-paint. -1 if there is none.
+    qint64 intervalNs(TestWindow::EventType from, TestWindow::EventType to) const;
+    // Time between consecutive events of the given type, for example paint spacing.
+    QVector<qint64> spacingNs(TestWindow::EventType type) const;
+
+private:
+    TestWindowTraceEvent events[Capacity];
+    int first;
+    int size;
+};
+
 class TestWindowImplBase
 {
 public:
@@ -112,6 +204,7 @@ public:
 
     static void resetWindowCounter();
     static int windowCount();
+    static QSet<TestWindowImplBase *> *liveInstances();
 
     void resetCounters();
     int eventCount(TestWindow::EventType type);
@@ -123,10 +216,20 @@ public:
     void mousePressEventHandler(QMouseEvent * ev);
     void mouseReleaseEventHandler(QMouseEvent * ev);
     void exposeEventHandler(QExposeEvent *ev);
-    void paintEventHandler(QPaintEvent *ev);
+    void paintEventHandler(QPaintEvent *ev, QSize framebufferSize = QSize());
+    virtual QImage grabContent() = 0;
+    virtual qint64 estimatedBytes() const = 0;
+    virtual void scheduleFrame() = 0; // for continuousUpdate
 
     static int instanceCount;
+    TestWindow::WindowConfiguration configuration;
     int eventCounts[TestWindow::EventTypesCount];
+    TestWindowTrace trace;
+    bool poolable;
+    bool continuousUpdate;
+    int glTriangleCount;
+    Workload workload;
+    int workloadFrame;
     bool forwardEvents;  // Controls whether events are accepted
     QColor fillColor;
 };
@@ -135,6 +238,7 @@ class TestWindowImplRaster : public QRasterWindow, public TestWindowImplBase
 {
 public:
     TestWindowImplRaster()
+        : backingStoreImage(0)
     {
         setGeometry(100, 100, 100, 100);
     }
@@ -156,7 +260,37 @@ public:
         foreach (QRect rect, ev->region().rects()) {
             p.fillRect(rect, fillColor);
         }
+        if (!workload.isEmpty()) {
+            p.setClipRegion(ev->region());
+            workload.paint(&p, size(), workloadFrame++);
+        }
+
+        // The painter is redirected to the backing store; remember its image for
+        // grabContent(). This is the backing store's own QImage, which outlives
+        // the paint; its pixels are only read (and copied) by grabContent().
+        QPaintDevice *device = p.paintEngine()->paintDevice();
+        backingStoreImage = (device->devType() == QInternal::Image) ? static_cast<QImage *>(device) : 0;
+
+        if (continuousUpdate)
+            scheduleFrame();
+    }
+    // QPaintDeviceWindow drops an UpdateRequest when nothing is dirty, so
+    // mark the window dirty; update() is paced with requestUpdate() internally.
+    void scheduleFrame() Q_DECL_OVERRIDE { update(); }
+    void resizeEvent(QResizeEvent *ev) Q_DECL_OVERRIDE
+    {
+        backingStoreImage = 0; // the backing store reallocates
+        QRasterWindow::resizeEvent(ev);
+    }
+    QImage grabContent() Q_DECL_OVERRIDE;
+    qint64 estimatedBytes() const Q_DECL_OVERRIDE
+    {
+        // One backing store image
+        qreal dpr = devicePixelRatio();
+        return qint64(width() * dpr) * qint64(height() * dpr) * 4;
     }
+
+    const QImage *backingStoreImage;
 };
 
 class TestWindowImplOpenGL : public QOpenGLWindow, public TestWindowImplBase
@@ -164,10 +298,21 @@ class TestWindowImplOpenGL : public QOpenGLWindow, public TestWindowImplBase
 public:
     TestWindowImplOpenGL()
         :QOpenGLWindow(QOpenGLWindow::NoPartialUpdate), TestWindowImplBase()
+        , renderer(0)
+        , frame(0)
     {
         setGeometry(100, 100, 100, 100);
     }
 
+    ~TestWindowImplOpenGL()
+    {
+        if (renderer) {
+            makeCurrent();
+            delete renderer;
+            doneCurrent();
+        }
+    }
+
     void keyPressEvent(QKeyEvent * ev) Q_DECL_OVERRIDE { keyPressEventHandler(ev); }
     void keyReleaseEvent(QKeyEvent * ev) Q_DECL_OVERRIDE { keyReleaseEventHandler(ev); }
     void mousePressEvent(QMouseEvent * ev) Q_DECL_OVERRIDE { mousePressEventHandler(ev); }
@@ -179,11 +324,73 @@ public:
     }
     void paintGL() Q_DECL_OVERRIDE
     {
-        paintEventHandler(0);
+        paintEventHandler(0, size() * devicePixelRatio());
+
+        if (glTriangleCount > 0) {
+            if (!renderer)
+                renderer = new GLContentRenderer(glTriangleCount);
+            renderer->setTriangleCount(glTriangleCount);
+            renderer->render(frame++);
+        } else {
+            glClearColor(fillColor.redF(), fillColor.greenF(), fillColor.blueF(), fillColor.alphaF());
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        if (!workload.isEmpty()) {
+            QPainter p(this);
+            workload.paint(&p, size(), workloadFrame++);
+        }
 
-        glClearColor(fillColor.redF(), fillColor.greenF(), fillColor.blueF(), fillColor.alphaF());
-        glClear(GL_COLOR_BUFFER_BIT);
+        if (continuousUpdate)
+            scheduleFrame();
+    }
+    void scheduleFrame() Q_DECL_OVERRIDE { requestUpdate(); }
+    QImage grabContent() Q_DECL_OVERRIDE;
+    qint64 estimatedBytes() const Q_DECL_OVERRIDE
+    {
+        // Double buffered color plus depth/stencil
+        qreal dpr = devicePixelRatio();
+        return qint64(width() * dpr) * qint64(height() * dpr) * 4 * 3;
     }
+
+private:
+    GLContentRenderer *renderer;
+    int frame;
+};
+
+// Frame pacing statistics for a sequence of frame intervals, for example
+// TestWindowTrace::spacingNs(TestWindow::PaintEvent). A frame is missed
+// for every refresh interval beyond the first that a frame interval spans.
+struct FrameStatistics
+{
+    int frameCount;
+    qreal fps;
+    qint64 p50Ns;
+    qint64 p90Ns;
+    qint64 p99Ns;
+    int missedFrames;
+    qint64 longestStallNs;
+
+    static FrameStatistics fromIntervals(const QVector<qint64> &intervalsNs, qreal refreshRate);
+    QString toString() const;
+};
+
+// Input latency: the time from QNativeInput::sendNativeEvent() until the
+// corresponding QMouseEvent or QKeyEvent reaches a TestWindow. Sent events
+// are matched to delivered events in order, per event type. Latencies are
+// collected per event type and window configuration for the whole test run.
+class InputLatency
+{
+public:
+    static void install();
+    static void clearPending(); // call before sending, drops unmatched sends
+    static void eventSent(const QNativeEvent &event, qint64 sendTimeNs);
+    static void eventDelivered(TestWindow::EventType type, TestWindow::WindowConfiguration configuration);
+    static void nativeViewEventDelivered(TestWindow::EventType type); // plain NSView, no QWindow
+
+    static int sampleCount(TestWindow::EventType type, TestWindow::WindowConfiguration configuration);
+    static qint64 percentileNs(TestWindow::EventType type, TestWindow::WindowConfiguration configuration,
+                               int percentile);
+    static QString report();
 };
 
 // Macro for iterating over window configurations. 
@@ -271,8 +478,65 @@ CGImageRef grabScreen(NSWindow *window);
 QImage grabScreen(QWindow *window);
 QImage grabScreen(TestWindow *window);
 
-// Tests if pixels inside a rect are of the given color.
+// Compares every pixel inside a rect against a color or a reference image
+// (which has the size of the rect), allowing a +-tolerance difference per
+// RGB channel (clamped to 0..255). Alpha is ignored. Parts of the rect
+// outside the image are not compared; a rect entirely outside the image is
+// a full mismatch. The diff mask is only created on request; it is an
+// Indexed8 image of the size of the rect, with 1 for mismatches.
+struct ImageComparison
+{
+    ImageComparison() : mismatchCount(0) {}
+    bool matches() const { return mismatchCount == 0; }
+
+    int mismatchCount;
+    QRect mismatchRect; // bounding box of the mismatching pixels, image coordinates
+    QImage diffMask;
+};
+
+ImageComparison compareImage(const QImage &image, QRect rect, QColor color,
+                             int tolerance = 1, bool createDiffMask = false);
+ImageComparison compareImage(const QImage &image, QRect rect, const QImage &reference,
+                             int tolerance = 1, bool createDiffMask = false);
+
+// Tests if pixels inside a rect are of the given color. The outer 5 pixels
+// of the rect are not tested. Writes "grabbed.png" and "diff.png" on failure.
 bool verifyImage(const QImage &image, QRect rect, QColor color);
 bool verifyImage(const QImage &image, QColor color);
 
+// Golden image store for verifying rich content. References are stored as
+// PNG files in TESTGOLDENDIR (default: the golden directory next to this
+// file) together with index.txt, which holds the content hash of each
+// reference. Keys are built from the current test function, data row,
+// window configuration and an optional tag.
+//
+// A frame is accepted if its content hash matches the index. On a hash
+// mismatch the reference PNG is loaded and compared with compareImage()
+// within the given tolerance; hashes accepted this way are remembered for
+// the rest of the run. Set TESTGOLDENUPDATE=1 to (re)record all verified
+// references in bulk instead of comparing.
+class GoldenImages
+{
+public:
+    enum Result { HashMatch, ToleranceMatch, Mismatch, Missing, Updated };
+
+    static QString key(TestWindow::WindowConfiguration configuration, const QString &tag = QString());
+    static QByteArray contentHash(const QImage &image);
+    static Result verify(const QImage &image, const QString &key, int tolerance = 1);
+    static bool isUpdating();
+    static QString report();
+};
+
+// Fails on mismatch. A missing reference skips the rest of the test
+// function instead of passing, since references are recorded per reference
+// machine and are not committed for every configuration.
+#define QVERIFY_GOLDEN(image, configuration, tag) \
+    do { \
+        GoldenImages::Result _goldenResult = \
+            GoldenImages::verify(image, GoldenImages::key(configuration, tag)); \
+        if (_goldenResult == GoldenImages::Missing) \
+            QSKIP("No golden reference, record with TESTGOLDENUPDATE=1"); \
+        QVERIFY(_goldenResult != GoldenImages::Mismatch); \
+    } while (0)
+
 #endif
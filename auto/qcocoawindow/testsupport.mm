@@ -3,10 +3,54 @@
 #include <QtTest/QTest>
 #include <QtGui/QtGui>
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 Q_GLOBAL_STATIC(QList<TestWindow *>, testWindows);
 
+struct PooledWindow
+{
+    QPaintDeviceWindow *window;
+    TestWindowImplBase *impl;
+};
+Q_GLOBAL_STATIC(QList<PooledWindow>, windowPool);
+static bool windowPoolEnabled = qEnvironmentVariableIntValue("TESTWINDOWPOOL") > 0;
+static const int maxPooledWindows = 8;
+
+// Returns a pooled window to the state of a newly created TestWindow.
+static void resetPooledWindow(QPaintDeviceWindow *window, TestWindowImplBase *impl)
+{
+    window->setFlags(Qt::Window);
+    window->setMask(QRegion());
+    window->setMinimumSize(QSize(0, 0));
+    window->setMaximumSize(QSize(QWINDOWSIZE_MAX, QWINDOWSIZE_MAX));
+    window->setGeometry(100, 100, 100, 100);
+    impl->fillColor = QColor(Qt::green);
+    impl->continuousUpdate = false;
+    impl->workload.setParameters(WorkloadParameters());
+    impl->forwardEvents = false;
+    impl->resetCounters();
+}
+
 TestWindow *TestWindow::createWindow(TestWindow::WindowConfiguration configuration)
 {
+    if (windowPoolEnabled) {
+        QList<PooledWindow> *pool = windowPool();
+        for (int i = 0; i < pool->size(); ++i) {
+            if (pool->at(i).impl->configuration != configuration)
+                continue;
+            PooledWindow pooled = pool->takeAt(i);
+            resetPooledWindow(pooled.window, pooled.impl);
+            TestWindow *testWindow = new TestWindow(pooled.window, pooled.impl);
+            testWindows()->append(testWindow);
+            return testWindow;
+        }
+    }
+
     QPaintDeviceWindow *window = 0;
     TestWindowImplBase *baseWindow = 0;
  
@@ -20,6 +64,7 @@ TestWindow *TestWindow::createWindow(TestWindow::WindowConfiguration configurati
         window = w;
         baseWindow = w;
     }
+    baseWindow->configuration = configuration;
 
     // Select Layer-backed/Classic
     if (isLayeredWindow(configuration))
@@ -31,6 +76,49 @@ TestWindow *TestWindow::createWindow(TestWindow::WindowConfiguration configurati
     return testWindow;
 }
 
+void TestWindow::setPoolEnabled(bool enable)
+{
+    windowPoolEnabled = enable;
+    if (!enable)
+        drainPool();
+}
+
+bool TestWindow::isPoolEnabled()
+{
+    return windowPoolEnabled;
+}
+
+void TestWindow::drainPool()
+{
+    QList<PooledWindow> *pool = windowPool();
+    if (pool->isEmpty())
+        return;
+    foreach (const PooledWindow &pooled, *pool)
+        delete pooled.impl;
+    pool->clear();
+
+    // Flush out the native windows, see ~TestWindow()
+    NSWindow *dummy = [[NSWindow alloc] init];
+    [dummy makeKeyAndOrderFront:nil];
+    [dummy close];
+}
+
+int TestWindow::liveWindowCount()
+{
+    return TestWindowImplBase::liveInstances()->size() - windowPool()->size();
+}
+
+qint64 TestWindow::estimatedLiveWindowBytes()
+{
+    QSet<TestWindowImplBase *> live = *TestWindowImplBase::liveInstances();
+    foreach (const PooledWindow &pooled, *windowPool())
+        live.remove(pooled.impl);
+    qint64 bytes = 0;
+    foreach (TestWindowImplBase *impl, live)
+        bytes += impl->estimatedBytes();
+    return bytes;
+}
+
 void TestWindow::deleteOpenWindows()
 {
     foreach(TestWindow *testWindow, *testWindows()) {
@@ -81,6 +169,16 @@ TestWindow::TestWindow(QPaintDeviceWindow *_dwin, TestWindowImplBase *_dbase)
 TestWindow::~TestWindow()
 {
     testWindows()->removeAll(this);
+
+    // Keep the window for reuse. It stays open natively, so there is
+    // nothing to flush.
+    if (d && windowPoolEnabled && d->poolable && windowPool()->size() < maxPooledWindows) {
+        dwin->hide();
+        PooledWindow pooled = { dwin, d };
+        windowPool()->append(pooled);
+        return;
+    }
+
     delete d;
 
     // Create and make a dummy window key/front in order
@@ -91,6 +189,14 @@ TestWindow::~TestWindow()
 
 }
 
+void TestWindow::setParent(TestWindow *parent)
+{
+    // Window hierarchies are not reset for reuse.
+    d->poolable = false;
+    parent->d->poolable = false;
+    dwin->setParent(parent->qwindow());
+}
+
 QWindow *TestWindow::qwindow()
 {
     return dwin;
@@ -124,11 +230,123 @@ bool TestWindow::takeOneOrManyEvents(EventType type)
     return d->takeOneOrManyEvents(type);
 }
 
+QImage TestWindow::grabContent()
+{
+    return d->grabContent();
+}
+
+QImage TestWindowImplRaster::grabContent()
+{
+    if (!backingStoreImage)
+        return QImage();
+
+    // Copy: the backing store pixels are reused by the next paint.
+    const QImage &image = *backingStoreImage;
+    if (image.devicePixelRatio() != 1.0)
+        return image.scaled(size());
+    return image.copy();
+}
+
+QImage TestWindowImplOpenGL::grabContent()
+{
+    if (!isValid())
+        return QImage();
+
+    QImage content = grabFramebuffer();
+    if (content.devicePixelRatio() != 1.0)
+        return content.scaled(size());
+    return content;
+}
+
+const TestWindowTrace &TestWindow::trace() const
+{
+    return d->trace;
+}
+
+struct WaitStatistics
+{
+    WaitStatistics() : count(0), timeouts(0), totalNs(0), maxNs(0) {}
+    int count;
+    int timeouts;
+    qint64 totalNs;
+    qint64 maxNs;
+};
+Q_GLOBAL_STATIC(WaitStatistics, waitStatistics);
+
+template <typename Condition>
+static bool waitForCondition(Condition condition, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    bool met = condition();
+    while (!met && timer.elapsed() < timeoutMs) {
+        QTest::qWait(1);
+        met = condition();
+    }
+
+    WaitStatistics *stats = waitStatistics();
+    qint64 elapsed = timer.nsecsElapsed();
+    ++stats->count;
+    stats->timeouts += met ? 0 : 1;
+    stats->totalNs += elapsed;
+    stats->maxNs = qMax(stats->maxNs, elapsed);
+    if (qEnvironmentVariableIsSet("TESTWAITDEBUG"))
+        qDebug() << (met ? "waited" : "timed out after") << elapsed / 1000 << "us";
+    return met;
+}
+
+bool TestWindow::waitForEvent(EventType type, int count, int timeoutMs)
+{
+    return waitForCondition([this, type, count]() { return d->eventCount(type) >= count; }, timeoutMs);
+}
+
+bool TestWindow::waitForGeometry(QRect geometry, int timeoutMs)
+{
+    return waitForCondition([this, geometry]() {
+        return screenGeometry(this) == geometry
+            && screenGeometry(getNSWindow(this)) == geometry
+            && screenGeometry(getNSView(this)) == geometry;
+    }, timeoutMs);
+}
+
+QString TestWindow::waitReport()
+{
+    WaitStatistics *stats = waitStatistics();
+    return QString("Condition waits: %1, total %2 ms, longest %3 ms, %4 timed out")
+        .arg(stats->count).arg(stats->totalNs / 1000000).arg(stats->maxNs / 1000000).arg(stats->timeouts);
+}
+
 void TestWindow::setFillColor(QColor color)
 {
     d->fillColor = color; 
 }
 
+void TestWindow::setContinuousUpdate(bool enable)
+{
+    d->continuousUpdate = enable;
+    if (enable)
+        d->scheduleFrame();
+}
+
+void TestWindow::setGLContent(int triangleCount)
+{
+    if (isRasterWindow(d->configuration))
+        return;
+    if (dwin->handle() && dwin->format().profile() != QSurfaceFormat::CoreProfile)
+        qWarning() << "TestWindow::setGLContent: the window has already been created without a core profile format";
+    else
+        dwin->setFormat(GLContentRenderer::format());
+    d->glTriangleCount = triangleCount;
+    d->poolable = false;
+}
+
+void TestWindow::setWorkload(const WorkloadParameters &parameters)
+{
+    d->workload.setParameters(parameters);
+    d->workloadFrame = 0;
+    dwin->update();
+}
+
 void TestWindow::setForwardEvents(bool forward)
 {
     d->forwardEvents = forward;
@@ -145,14 +363,27 @@ void TestWindow::repaint()
 
 TestWindowImplBase::TestWindowImplBase()
 {
+    configuration = TestWindow::Raster;
+    poolable = true;
+    continuousUpdate = false;
+    glTriangleCount = 0;
+    workloadFrame = 0;
     forwardEvents = false;
     fillColor = QColor(Qt::green);
     ++instanceCount;
+    liveInstances()->insert(this);
 }
 
 TestWindowImplBase::~TestWindowImplBase()
 {
     --instanceCount;
+    liveInstances()->remove(this);
+}
+
+QSet<TestWindowImplBase *> *TestWindowImplBase::liveInstances()
+{
+    static QSet<TestWindowImplBase *> instances;
+    return &instances;
 }
 
 int TestWindowImplBase::instanceCount = 0;
@@ -171,6 +402,7 @@ void TestWindowImplBase::resetCounters()
 {
     for (int i = 0; i < TestWindow::EventTypesCount; ++i)
         eventCounts[i] = 0;
+    trace.clear();
 }
 
 int TestWindowImplBase::eventCount(TestWindow::EventType type)
@@ -198,37 +430,304 @@ void TestWindowImplBase::keyPressEventHandler(QKeyEvent * ev)
 {
     ev->setAccepted(!forwardEvents);
     eventCounts[TestWindow::KeyDownEvent] += forwardEvents ? 0 : 1;
+    if (!forwardEvents) {
+        trace.record(TestWindow::KeyDownEvent);
+        InputLatency::eventDelivered(TestWindow::KeyDownEvent, configuration);
+    }
 }
 
 void TestWindowImplBase::keyReleaseEventHandler(QKeyEvent * ev)
 {
     ev->setAccepted(!forwardEvents);
     eventCounts[TestWindow::KeyUpEvent] += forwardEvents ? 0 : 1;
+    if (!forwardEvents) {
+        trace.record(TestWindow::KeyUpEvent);
+        InputLatency::eventDelivered(TestWindow::KeyUpEvent, configuration);
+    }
 }
 
 void TestWindowImplBase::mousePressEventHandler(QMouseEvent * ev)
 {
     ev->setAccepted(!forwardEvents);
     eventCounts[TestWindow::MouseDownEvent] += forwardEvents ? 0 : 1;
+    if (!forwardEvents) {
+        trace.record(TestWindow::MouseDownEvent);
+        InputLatency::eventDelivered(TestWindow::MouseDownEvent, configuration);
+    }
 }
 
 void TestWindowImplBase::mouseReleaseEventHandler(QMouseEvent * ev)
 {
     ev->setAccepted(!forwardEvents);
     eventCounts[TestWindow::MouseUpEvent] += forwardEvents ? 0 : 1;
+    if (!forwardEvents) {
+        trace.record(TestWindow::MouseUpEvent);
+        InputLatency::eventDelivered(TestWindow::MouseUpEvent, configuration);
+    }
 }
 
 void TestWindowImplBase::exposeEventHandler(QExposeEvent *ev)
 {
-    if (ev->region().isEmpty())
+    if (ev->region().isEmpty()) {
         ++eventCounts[TestWindow::ObscureEvent];
-    else
+        trace.record(TestWindow::ObscureEvent);
+    } else {
         ++eventCounts[TestWindow::ExposeEvent];
+        int area = 0;
+        const QRegion &region = ev->region();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+        for (QRegion::const_iterator it = region.begin(); it != region.end(); ++it)
+            area += it->width() * it->height();
+#else
+        foreach (const QRect &rect, region.rects())
+            area += rect.width() * rect.height();
+#endif
+        trace.record(TestWindow::ExposeEvent, area);
+    }
 }
 
-void TestWindowImplBase::paintEventHandler(QPaintEvent *)
+void TestWindowImplBase::paintEventHandler(QPaintEvent *ev, QSize framebufferSize)
 {
     ++eventCounts[TestWindow::PaintEvent];
+    trace.record(TestWindow::PaintEvent, 0, ev ? ev->region().boundingRect() : QRect(), framebufferSize);
+}
+
+TestWindowTrace::TestWindowTrace()
+{
+    clear();
+}
+
+void TestWindowTrace::clear()
+{
+    first = 0;
+    size = 0;
+}
+
+void TestWindowTrace::record(TestWindow::EventType type, int exposeArea, QRect paintRect,
+                             QSize framebufferSize)
+{
+    TestWindowTraceEvent &event = events[(first + size) % Capacity];
+    if (size < Capacity)
+        ++size;
+    else
+        first = (first + 1) % Capacity;
+
+    event.type = type;
+    event.timestampNs = QNativeInput::monotonicNs();
+    event.exposeArea = exposeArea;
+    event.paintRect = paintRect;
+    event.framebufferSize = framebufferSize;
+}
+
+int TestWindowTrace::indexOf(TestWindow::EventType type, int from) const
+{
+    for (int i = qMax(from, 0); i < size; ++i) {
+        if (at(i).type == type)
+            return i;
+    }
+    return -1;
+}
+
+int TestWindowTrace::eventCount(TestWindow::EventType type) const
+{
+    int count = 0;
+    for (int i = 0; i < size; ++i)
+        count += (at(i).type == type) ? 1 : 0;
+    return count;
+}
+
+qint64 TestWindowTrace::intervalNs(TestWindow::EventType from, TestWindow::EventType to) const
+{
+    int fromIndex = indexOf(from);
+    if (fromIndex < 0)
+        return -1;
+    int toIndex = indexOf(to, fromIndex + 1);
+    if (toIndex < 0)
+        return -1;
+    return at(toIndex).timestampNs - at(fromIndex).timestampNs;
+}
+
+QVector<qint64> TestWindowTrace::spacingNs(TestWindow::EventType type) const
+{
+    QVector<qint64> spacing;
+    int previous = indexOf(type);
+    while (previous >= 0) {
+        int next = indexOf(type, previous + 1);
+        if (next < 0)
+            break;
+        spacing.append(at(next).timestampNs - at(previous).timestampNs);
+        previous = next;
+    }
+    return spacing;
+}
+
+static qint64 percentile(const QVector<qint64> &sorted, int percentile)
+{
+    if (sorted.isEmpty())
+        return -1;
+    int rank = qMax(1, int(std::ceil(percentile / 100.0 * sorted.size())));
+    return sorted.at(qMin(rank, sorted.size()) - 1);
+}
+
+FrameStatistics FrameStatistics::fromIntervals(const QVector<qint64> &intervalsNs, qreal refreshRate)
+{
+    FrameStatistics stats;
+    QVector<qint64> sorted = intervalsNs;
+    std::sort(sorted.begin(), sorted.end());
+
+    qint64 totalNs = 0;
+    foreach (qint64 interval, sorted)
+        totalNs += interval;
+
+    stats.frameCount = sorted.size();
+    stats.fps = totalNs > 0 ? sorted.size() * 1e9 / totalNs : 0;
+    stats.p50Ns = percentile(sorted, 50);
+    stats.p90Ns = percentile(sorted, 90);
+    stats.p99Ns = percentile(sorted, 99);
+    stats.longestStallNs = sorted.isEmpty() ? 0 : sorted.last();
+
+    // Intervals up to 1.5 refresh intervals count as on time.
+    stats.missedFrames = 0;
+    qreal refreshNs = 1e9 / (refreshRate > 0 ? refreshRate : 60);
+    foreach (qint64 interval, sorted)
+        stats.missedFrames += qMax(0, int(interval / refreshNs + 0.5) - 1);
+    return stats;
+}
+
+QString FrameStatistics::toString() const
+{
+    return QString("%1 frames, %2 fps, interval p50 %3 ms p90 %4 ms p99 %5 ms, "
+                   "%6 missed frames, longest stall %7 ms")
+        .arg(frameCount).arg(fps, 0, 'f', 1)
+        .arg(p50Ns / 1e6, 0, 'f', 2).arg(p90Ns / 1e6, 0, 'f', 2).arg(p99Ns / 1e6, 0, 'f', 2)
+        .arg(missedFrames).arg(longestStallNs / 1e6, 0, 'f', 2);
+}
+
+// Samples for native views are kept in an extra row after the window configurations.
+static const int NativeViewSamples = TestWindow::WindowConfigurationCount;
+
+struct InputLatencyData
+{
+    QMutex mutex; // sends may come from the injector thread
+    QQueue<qint64> pending[TestWindow::EventTypesCount];
+    QVector<qint64> samples[TestWindow::WindowConfigurationCount + 1][TestWindow::EventTypesCount];
+};
+Q_GLOBAL_STATIC(InputLatencyData, inputLatencyData);
+
+void InputLatency::install()
+{
+    QNativeInput::setSendHook(&InputLatency::eventSent);
+}
+
+void InputLatency::clearPending()
+{
+    InputLatencyData *d = inputLatencyData();
+    QMutexLocker lock(&d->mutex);
+    for (int i = 0; i < TestWindow::EventTypesCount; ++i)
+        d->pending[i].clear();
+}
+
+void InputLatency::eventSent(const QNativeEvent &event, qint64 sendTimeNs)
+{
+    TestWindow::EventType type;
+    switch (event.id()) {
+        case QNativeMouseButtonEvent::eventId:
+            type = static_cast<const QNativeMouseButtonEvent &>(event).clickCount > 0
+                ? TestWindow::MouseDownEvent : TestWindow::MouseUpEvent;
+            break;
+        case QNativeKeyEvent::eventId:
+            type = static_cast<const QNativeKeyEvent &>(event).press
+                ? TestWindow::KeyDownEvent : TestWindow::KeyUpEvent;
+            break;
+        default:
+            return;
+    }
+
+    InputLatencyData *d = inputLatencyData();
+    QMutexLocker lock(&d->mutex);
+    d->pending[type].enqueue(sendTimeNs);
+}
+
+static void recordDelivery(TestWindow::EventType type, int row)
+{
+    qint64 now = QNativeInput::monotonicNs();
+    InputLatencyData *d = inputLatencyData();
+    QMutexLocker lock(&d->mutex);
+    if (d->pending[type].isEmpty())
+        return; // not sent by us, for example QTest::keyClick()
+    d->samples[row][type].append(now - d->pending[type].dequeue());
+}
+
+void InputLatency::eventDelivered(TestWindow::EventType type, TestWindow::WindowConfiguration configuration)
+{
+    recordDelivery(type, configuration);
+}
+
+void InputLatency::nativeViewEventDelivered(TestWindow::EventType type)
+{
+    recordDelivery(type, NativeViewSamples);
+}
+
+static int sampleCount(TestWindow::EventType type, int row)
+{
+    InputLatencyData *d = inputLatencyData();
+    QMutexLocker lock(&d->mutex);
+    return d->samples[row][type].size();
+}
+
+// Nearest-rank percentile, or -1 if there are no samples.
+static qint64 percentileNs(TestWindow::EventType type, int row, int percentile)
+{
+    InputLatencyData *d = inputLatencyData();
+    QMutexLocker lock(&d->mutex);
+    QVector<qint64> sorted = d->samples[row][type];
+    std::sort(sorted.begin(), sorted.end());
+    return ::percentile(sorted, percentile);
+}
+
+int InputLatency::sampleCount(TestWindow::EventType type, TestWindow::WindowConfiguration configuration)
+{
+    return ::sampleCount(type, configuration);
+}
+
+qint64 InputLatency::percentileNs(TestWindow::EventType type, TestWindow::WindowConfiguration configuration,
+                                  int percentile)
+{
+    return ::percentileNs(type, configuration, percentile);
+}
+
+QString InputLatency::report()
+{
+    static const struct {
+        TestWindow::EventType type;
+        const char *name;
+    } types[] = {
+        { TestWindow::MouseDownEvent, "mouse down" },
+        { TestWindow::MouseUpEvent, "mouse up" },
+        { TestWindow::KeyDownEvent, "key down" },
+        { TestWindow::KeyUpEvent, "key up" },
+    };
+
+    QString report;
+    QTextStream s(&report);
+    s << "Input latency (send to delivery), microseconds:\n";
+    for (int row = 0; row <= NativeViewSamples; ++row) {
+        QByteArray rowName = row == NativeViewSamples ? QByteArray("native")
+            : TestWindow::windowConfigurationName(TestWindow::WindowConfiguration(row));
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+            int count = ::sampleCount(types[i].type, row);
+            if (count == 0)
+                continue;
+            s << "  " << rowName.leftJustified(8).constData()
+              << QByteArray(types[i].name).leftJustified(12).constData()
+              << " n " << count
+              << " p50 " << ::percentileNs(types[i].type, row, 50) / 1000
+              << " p95 " << ::percentileNs(types[i].type, row, 95) / 1000
+              << " p99 " << ::percentileNs(types[i].type, row, 99) / 1000 << "\n";
+        }
+    }
+    s.flush();
+    return report;
 }
 
 QColor toQColor(NSColor *color) {
@@ -323,9 +822,9 @@ NSOpenGLPixelFormat *getNSOpenGLPixelFormat(TestWindow *window)
 
 void waitForWindowVisible(TestWindow *window)
 {
-    // use qWaitForWindowExposed for now.
+    // use qWaitForWindowExposed for now, then wait for the first paint.
     QTest::qWaitForWindowExposed(window->qwindow());
-    WAIT
+    window->waitForEvent(TestWindow::PaintEvent);
 }
 
 #if 0
@@ -578,42 +1077,315 @@ QImage grabScreen(TestWindow *window)
     return grabScreen(window->qwindow());
 }
 
+// Returns the image in a format with 0xAARRGGBB pixels.
+static QImage toRgb32Layout(const QImage &image)
+{
+    switch (image.format()) {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            return image;
+        default:
+            return image.convertToFormat(QImage::Format_ARGB32);
+    }
+}
+
+// Compares one scanline and returns the number of mismatching pixels. For
+// SolidColor, expected points to a single pixel value. Mismatching pixels
+// extend [first, last] and are set to 1 in mask, if given.
+template <bool SolidColor>
+static int compareScanline(const quint32 *line, const quint32 *expected, int width, int tolerance,
+                           int *first, int *last, uchar *mask)
+{
+    const quint32 rgbMask = 0x00ffffff;
+    int mismatches = 0;
+    int x = 0;
+
+#ifdef __SSE2__
+    // Four pixels at a time: per-byte absolute difference, minus the
+    // tolerance with saturation; a pixel matches if all its RGB bytes are 0.
+    const __m128i vtolerance = _mm_set1_epi8(char(tolerance));
+    const __m128i vrgbMask = _mm_set1_epi32(rgbMask);
+    const __m128i vzero = _mm_setzero_si128();
+    const __m128i vsolid = _mm_set1_epi32(int(*expected));
+    for (; x + 4 <= width; x += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + x));
+        __m128i b = SolidColor ? vsolid : _mm_loadu_si128(reinterpret_cast<const __m128i *>(expected + x));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        diff = _mm_and_si128(_mm_subs_epu8(diff, vtolerance), vrgbMask);
+        int matchBits = _mm_movemask_epi8(_mm_cmpeq_epi32(diff, vzero));
+        if (matchBits == 0xffff)
+            continue;
+        for (int i = 0; i < 4; ++i) {
+            if (((matchBits >> (4 * i)) & 0xf) == 0xf)
+                continue;
+            ++mismatches;
+            *first = qMin(*first, x + i);
+            *last = qMax(*last, x + i);
+            if (mask)
+                mask[x + i] = 1;
+        }
+    }
+#endif
+
+    for (; x < width; ++x) {
+        quint32 a = line[x];
+        quint32 b = SolidColor ? *expected : expected[x];
+        if (((a ^ b) & rgbMask) == 0)
+            continue;
+        if (qAbs(qRed(a) - qRed(b)) <= tolerance
+            && qAbs(qGreen(a) - qGreen(b)) <= tolerance
+            && qAbs(qBlue(a) - qBlue(b)) <= tolerance)
+            continue;
+        ++mismatches;
+        *first = qMin(*first, x);
+        *last = qMax(*last, x);
+        if (mask)
+            mask[x] = 1;
+    }
+    return mismatches;
+}
+
+template <bool SolidColor>
+static ImageComparison compareImageHelper(const QImage &sourceImage, QRect rect, const quint32 *solid,
+                                          const QImage &sourceReference, int tolerance, bool createDiffMask)
+{
+    ImageComparison result;
+    QImage image = toRgb32Layout(sourceImage);
+    QImage reference = SolidColor ? QImage() : toRgb32Layout(sourceReference);
+    tolerance = qBound(0, tolerance, 255); // per-byte saturating arithmetic below
+
+    // Only the part of the rect inside the image is compared. The reference
+    // and the diff mask cover the whole rect; offset them by the clipped amount.
+    const QRect requested = rect;
+    rect &= image.rect();
+    if (rect.isEmpty()) {
+        // Nothing could be compared: report everything as mismatching.
+        result.mismatchCount = requested.width() * requested.height();
+        result.mismatchRect = requested;
+        return result;
+    }
+    const QPoint offset = rect.topLeft() - requested.topLeft();
+
+    if (createDiffMask) {
+        result.diffMask = QImage(requested.size(), QImage::Format_Indexed8);
+        result.diffMask.setColorTable(QVector<QRgb>() << qRgb(0, 0, 0) << qRgb(255, 0, 0));
+        result.diffMask.fill(0);
+    }
+
+    int top = INT_MAX, bottom = -1, left = INT_MAX, right = -1;
+    for (int y = 0; y < rect.height(); ++y) {
+        const quint32 *line = reinterpret_cast<const quint32 *>(image.constScanLine(rect.y() + y)) + rect.x();
+        const quint32 *expected = SolidColor ? solid
+            : reinterpret_cast<const quint32 *>(reference.constScanLine(offset.y() + y)) + offset.x();
+        uchar *mask = createDiffMask ? result.diffMask.scanLine(offset.y() + y) + offset.x() : 0;
+        int first = INT_MAX, last = -1;
+        int mismatches = compareScanline<SolidColor>(line, expected, rect.width(), tolerance,
+                                                     &first, &last, mask);
+        if (mismatches) {
+            result.mismatchCount += mismatches;
+            top = qMin(top, y);
+            bottom = y;
+            left = qMin(left, first);
+            right = qMax(right, last);
+        }
+    }
+
+    if (result.mismatchCount)
+        result.mismatchRect = QRect(QPoint(left, top), QPoint(right, bottom)).translated(rect.topLeft());
+    return result;
+}
+
+ImageComparison compareImage(const QImage &image, QRect rect, QColor color, int tolerance, bool createDiffMask)
+{
+    const quint32 expected = color.rgb();
+    return compareImageHelper<true>(image, rect, &expected, QImage(), tolerance, createDiffMask);
+}
+
+ImageComparison compareImage(const QImage &image, QRect rect, const QImage &reference, int tolerance,
+                             bool createDiffMask)
+{
+    if (reference.size() != rect.size()) {
+        qWarning() << "compareImage: reference size" << reference.size() << "does not match" << rect.size();
+        ImageComparison result;
+        result.mismatchCount = rect.width() * rect.height();
+        result.mismatchRect = rect;
+        return result;
+    }
+    return compareImageHelper<false>(image, rect, 0, reference, tolerance, createDiffMask);
+}
+
 // Tests if pixels inside a rect are of the given color. The test is
 // fuzzy and allows a +-1 match on pixel RGB values.
 bool verifyImage(const QImage &image, QRect rect, QColor color)
 {
+    // Skip the edges, which may be anti-aliased window borders.
+    int offset = 5;
+    QRect tested = rect.adjusted(offset, offset, -offset, -offset);
+
+    ImageComparison result = compareImage(image, tested, color);
+    if (result.matches())
+        return true;
+
+    ImageComparison diff = compareImage(image, tested, color, 1, true);
     image.save("grabbed.png");
+    diff.diffMask.save("diff.png");
+    qWarning() << result.mismatchCount << "pixels differ from" << color << "in" << result.mismatchRect;
+    return false;
+}
 
-    int offset = 5;
-    int stride = 10;
-    for (int y = rect.y() + offset; y < rect.y() - offset + rect.height(); y += stride) {
-        for (int x = rect.x() + offset; x < rect.x() - offset + rect.width(); x += stride) {
-            QRgb pixel = image.pixel(x, y);
-            QRgb expected = color.rgb();
+bool verifyImage(const QImage &image, QColor color)
+{
+    return verifyImage(image, QRect(QPoint(0, 0), image.size()), color);
+}
 
-            if (pixel == expected)
-                continue;
+struct GoldenImageData
+{
+    GoldenImageData();
+    bool saveIndex() const;
 
-            // Allow off-by-one errors
-            if (qAbs(qRed(pixel) - qRed(expected) <= 1) &&
-                qAbs(qGreen(pixel) - qGreen(expected) <= 1) && 
-                qAbs(qBlue(pixel) - qBlue(expected) <= 1)) {
-                continue;
-            }
+    QString directory;
+    bool updating;
+    QMap<QString, QByteArray> index;               // key -> reference content hash
+    QHash<QString, QSet<QByteArray> > accepted;    // key -> hashes accepted within tolerance
+    QHash<QString, QImage> references;             // loaded reference images
+    int counts[GoldenImages::Updated + 1];
+};
 
-            // No match                    
-            qWarning() << "(" << x << y << ")\n"
-                       << qRed(pixel) << qBlue(pixel) << qGreen(pixel) << "\n"
-                       << qRed(expected) << qBlue(expected) << qGreen(expected);
-            return false;
-        }
+GoldenImageData::GoldenImageData()
+    : updating(qEnvironmentVariableIntValue("TESTGOLDENUPDATE") > 0)
+{
+    memset(counts, 0, sizeof(counts));
+    directory = qEnvironmentVariableIsSet("TESTGOLDENDIR")
+              ? QString::fromLocal8Bit(qgetenv("TESTGOLDENDIR")) : QStringLiteral(GOLDEN_IMAGE_DIR);
+
+    QFile file(directory + QStringLiteral("/index.txt"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+    while (!file.atEnd()) {
+        // "<hash> <key>", the key may contain spaces.
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        int space = line.indexOf(QLatin1Char(' '));
+        if (line.startsWith(QLatin1Char('#')) || space < 0)
+            continue;
+        index.insert(line.mid(space + 1), line.left(space).toLatin1());
     }
+}
 
-    // Match
+bool GoldenImageData::saveIndex() const
+{
+    QFile file(directory + QStringLiteral("/index.txt"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "GoldenImages: could not write" << file.fileName() << file.errorString();
+        return false;
+    }
+    QTextStream out(&file);
+    out << "# content hash, key\n";
+    for (QMap<QString, QByteArray>::const_iterator it = index.constBegin(); it != index.constEnd(); ++it)
+        out << it.value() << ' ' << it.key() << '\n';
     return true;
 }
 
-bool verifyImage(const QImage &image, QColor color)
+Q_GLOBAL_STATIC(GoldenImageData, goldenImageData);
+
+static QString goldenFileName(const QString &key)
 {
-    return verifyImage(image, QRect(QPoint(0, 0), image.size()), color);
+    QString name = key;
+    for (int i = 0; i < name.size(); ++i) {
+        QChar c = name.at(i);
+        if (!c.isLetterOrNumber() && c != QLatin1Char('-') && c != QLatin1Char('.'))
+            name[i] = QLatin1Char('_');
+    }
+    return goldenImageData()->directory + QLatin1Char('/') + name + QStringLiteral(".png");
+}
+
+QString GoldenImages::key(TestWindow::WindowConfiguration configuration, const QString &tag)
+{
+    QString key = QString::fromLatin1(QTest::currentTestFunction());
+    if (QTest::currentDataTag())
+        key += QLatin1Char('/') + QString::fromLatin1(QTest::currentDataTag());
+    key += QLatin1Char('/') + QString::fromLatin1(TestWindow::windowConfigurationName(configuration));
+    if (!tag.isEmpty())
+        key += QLatin1Char('/') + tag;
+    return key;
+}
+
+QByteArray GoldenImages::contentHash(const QImage &image)
+{
+    // Hash the RGB content only, like compareImage() compares it.
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    const qint32 size[2] = { rgb.width(), rgb.height() };
+    hash.addData(reinterpret_cast<const char *>(size), sizeof(size));
+    for (int y = 0; y < rgb.height(); ++y)
+        hash.addData(reinterpret_cast<const char *>(rgb.constScanLine(y)), rgb.width() * 4);
+    return hash.result().toHex();
+}
+
+GoldenImages::Result GoldenImages::verify(const QImage &image, const QString &key, int tolerance)
+{
+    GoldenImageData *d = goldenImageData();
+    QByteArray hash = contentHash(image);
+    QByteArray expected = d->index.value(key);
+    Result result;
+
+    if (d->updating) {
+        result = Updated;
+        if (hash != expected) {
+            QDir().mkpath(d->directory);
+            if (!image.convertToFormat(QImage::Format_RGB32).save(goldenFileName(key), "PNG")) {
+                qWarning() << "GoldenImages: could not save reference for" << key;
+                result = Mismatch;
+            } else {
+                d->index.insert(key, hash);
+                d->accepted.remove(key);
+                d->references.remove(key);
+                d->saveIndex();
+            }
+        }
+    } else if (expected.isEmpty()) {
+        qWarning() << "GoldenImages: no reference for" << key << "- record with TESTGOLDENUPDATE=1";
+        result = Missing;
+    } else if (hash == expected || d->accepted.value(key).contains(hash)) {
+        result = HashMatch;
+    } else {
+        // Hash mismatch, fall back to a tolerant comparison with the reference.
+        QHash<QString, QImage>::iterator reference = d->references.find(key);
+        if (reference == d->references.end())
+            reference = d->references.insert(key, QImage(goldenFileName(key)));
+        if (reference->isNull()) {
+            qWarning() << "GoldenImages: could not load reference" << goldenFileName(key);
+            result = Missing;
+        } else {
+            QRect rect(QPoint(0, 0), image.size());
+            ImageComparison comparison = compareImage(image, rect, *reference, tolerance);
+            if (comparison.matches()) {
+                d->accepted[key].insert(hash);
+                result = ToleranceMatch;
+            } else {
+                ImageComparison diff = compareImage(image, rect, *reference, tolerance, true);
+                image.save("grabbed.png");
+                diff.diffMask.save("diff.png");
+                qWarning() << comparison.mismatchCount << "pixels differ from reference" << key
+                           << "in" << comparison.mismatchRect;
+                result = Mismatch;
+            }
+        }
+    }
+
+    ++d->counts[result];
+    return result;
+}
+
+bool GoldenImages::isUpdating()
+{
+    return goldenImageData()->updating;
+}
+
+QString GoldenImages::report()
+{
+    GoldenImageData *d = goldenImageData();
+    return QString("Golden images: %1 hash matches, %2 tolerance matches, %3 mismatches, %4 missing, %5 updated")
+        .arg(d->counts[HashMatch]).arg(d->counts[ToleranceMatch]).arg(d->counts[Mismatch])
+        .arg(d->counts[Missing]).arg(d->counts[Updated]);
 }
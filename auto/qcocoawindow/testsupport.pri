@@ -0,0 +1,22 @@
+# Test support code shared by tst_qcocoawindow and the window benchmarks:
+# TestWindow, native events, the cocoaspy and the testbench content.
+
+# cocoaspy
+### fixme
+INCLUDEPATH += $$PWD/../../manual/testbench
+HEADERS += $$PWD/../../manual/testbench/cocoaspy.h
+OBJECTIVE_SOURCES += $$PWD/../../manual/testbench/cocoaspy.mm
+
+# testbench content (core profile GL renderer, workloads)
+HEADERS += $$PWD/../../manual/testbench/glcontent.h $$PWD/../../manual/testbench/workload.h
+SOURCES += $$PWD/../../manual/testbench/glcontent.cpp $$PWD/../../manual/testbench/workload.cpp
+
+# native events
+include($$PWD/nativeevents/nativeevents.pri)
+
+# autotest support code
+INCLUDEPATH += $$PWD
+HEADERS += $$PWD/testsupport.h
+OBJECTIVE_SOURCES += $$PWD/testsupport.mm
+LIBS += -framework AppKit
+DEFINES += GOLDEN_IMAGE_DIR=\\\"$$PWD/golden\\\"
@@ -9,6 +9,8 @@
 #include <cocoaspy.h>
 #include <nativeeventlist.h>
 #include <qnativeevents.h>
+#include <qnativeeventstream.h>
+#include <nativeeventtransform.h>
 
 #include "testsupport.h"
 
@@ -137,8 +139,11 @@ private slots:
     void nativeMouseEvents();
     void nativeKeyboardEvents();
     void nativeEventForwarding();
-    void mouseEvents();
-    void keyboardEvents();
+    void nativeEventStream();
+    void nativeEventCompactor();
+    void nativeEventGenerator();
+    void mouseEvents(); void mouseEvents_data();
+    void keyboardEvents(); void keyboardEvents_data();
     void eventForwarding();
 
     // Grahpics updates and expose
@@ -185,6 +190,7 @@ private slots:
 
 private:
     CGPoint m_cursorPosition; // initial cursor position
+    int m_liveWindowBaseline; // live TestWindows at init(), for strict leak checking
 };
 
 int iterations = 1;
@@ -293,6 +299,7 @@ void flushWithDummyWindow()
 
     // qDebug() << "left mouse down";
     ++self.mouseDownCount;
+    InputLatency::nativeViewEventDelivered(TestWindow::MouseDownEvent);
 }
 
 - (void)mouseUp:(NSEvent *)theEvent
@@ -304,6 +311,7 @@ void flushWithDummyWindow()
 
     // qDebug() << "left mouse up";
     ++self.mouseUpCount;
+    InputLatency::nativeViewEventDelivered(TestWindow::MouseUpEvent);
 }
 
 - (void)keyDown:(NSEvent *)theEvent
@@ -316,6 +324,7 @@ void flushWithDummyWindow()
     NSString *characters = [theEvent characters];
     // qDebug() << "key down" << QString::fromNSString(characters);
     ++self.keyDownCount;
+    InputLatency::nativeViewEventDelivered(TestWindow::KeyDownEvent);
 }
 
 - (void)keyUp:(NSEvent *)theEvent
@@ -328,6 +337,7 @@ void flushWithDummyWindow()
     NSString *characters = [theEvent characters];
     // qDebug() << "key up" << QString::fromNSString(characters);
     ++self.keyUpCount;
+    InputLatency::nativeViewEventDelivered(TestWindow::KeyUpEvent);
 }
 
 - (BOOL)performKeyEquivalent:(NSEvent *)theEvent
@@ -413,6 +423,8 @@ void tst_QCocoaWindow::initTestCase()
     // Some tests functions count keyboard events. The test executable may be
     // launched from a keydown event; give the keyup some time to clear.
     QTest::qWait(200);
+
+    InputLatency::install();
 }
 
 void tst_QCocoaWindow::cleanupTestCase()
@@ -422,6 +434,11 @@ void tst_QCocoaWindow::cleanupTestCase()
     events.append(new QNativeMouseMoveEvent(toQPoint(m_cursorPosition)));
     events.play();
     WAIT WAIT
+
+    qDebug().noquote() << InputLatency::report();
+    qDebug().noquote() << TestWindow::waitReport();
+    qDebug().noquote() << GoldenImages::report();
+    TestWindow::drainPool();
 }
 
 void tst_QCocoaWindow::init()
@@ -429,10 +446,29 @@ void tst_QCocoaWindow::init()
     // Select update implementation (timer / cvdisplaylink).
     QFETCH_GLOBAL(bool, displaylink);
     qputenv("QT_MAC_ENABLE_CVDISPLAYLINK", displaylink ? QByteArray("1") : QByteArray("0"));
+
+    // The instance management tests count native windows, which pooled
+    // windows would keep alive.
+    bool lifecycleTest = QByteArray(QTest::currentTestFunction()) == "construction"
+                      || QByteArray(QTest::currentTestFunction()) == "embed";
+    TestWindow::setPoolEnabled(!lifecycleTest && qEnvironmentVariableIntValue("TESTWINDOWPOOL") > 0);
+
+    m_liveWindowBaseline = TestWindow::liveWindowCount();
 }
 
 void tst_QCocoaWindow::cleanup()
 {
+    // Strict leak mode: every TestWindow created by the test function must
+    // have been deleted.
+    int leaked = TestWindow::liveWindowCount() - m_liveWindowBaseline;
+    if (leaked != 0 && qEnvironmentVariableIntValue("TESTWINDOWSTRICT") > 0 && !QTest::currentTestFailed()) {
+        QString message = QString("%1 TestWindows leaked (%2 live, baseline %3), ~%4 KB of window buffers")
+            .arg(leaked).arg(TestWindow::liveWindowCount()).arg(m_liveWindowBaseline)
+            .arg(TestWindow::estimatedLiveWindowBytes() / 1024);
+        TestWindow::deleteOpenWindows();
+        QFAIL(qPrintable(message));
+    }
+
     // Clean up windows left open by failing tests
     TestWindow::deleteOpenWindows();
 }
@@ -718,7 +754,7 @@ void tst_QCocoaWindow::geometry_toplevel()
         QRect geometry(101, 102, 103, 104);
         window->setGeometry(geometry);
         window->show();
-        WAIT WAIT
+        window->waitForGeometry(geometry);
 
         NSWindow *nswindow = getNSWindow(window);
         NSView *nsview = getNSView(window);
@@ -740,7 +776,7 @@ void tst_QCocoaWindow::geometry_toplevel()
         QRect geometry(101, 102, 103, 104);
         window->setGeometry(geometry);
         window->show();
-        WAIT WAIT
+        window->waitForGeometry(geometry);
 
         NSWindow *nswindow = getNSWindow(window);
         NSView *nsview = getNSView(window);
@@ -764,9 +800,8 @@ void tst_QCocoaWindow::geometry_toplevel()
         WAIT
 
         QRect geometry(101, 102, 103, 104);
-//        GEOMETRY_WAIT(window, window->setGeometry(geometry))
         window->setGeometry(geometry);
-        WAIT
+        window->waitForGeometry(geometry);
 
         NSWindow *nswindow = getNSWindow(window);
         NSView *nsview = getNSView(window);
@@ -792,7 +827,7 @@ void tst_QCocoaWindow::geometry_toplevel()
         QRect geometry2(111, 112, 113, 114);
         NSRect frame = nswindowFrameGeometry(geometry2, nswindow);
         [nswindow setFrame:frame display:YES animate:NO];
-        WAIT WAIT
+        window->waitForGeometry(geometry2);
 
         NSView *nsview = getNSView(window);
         QCOMPARE(screenGeometry(window), geometry2);
@@ -1206,7 +1241,8 @@ void tst_QCocoaWindow::visibility_child()
     }
 }
 
-// Verify that mouse event generation and processing works as expected for native views.
+// Verify that mouse event generation and processing works as expected for native
+// views. Delivery latency is collected by InputLatency.
 void tst_QCocoaWindow::nativeMouseEvents()
 {
 #ifndef HAVE_WORKING_CGEVENTPOST
@@ -1222,6 +1258,7 @@ void tst_QCocoaWindow::nativeMouseEvents()
         WAIT
 
         QPoint viewCenter = screenGeometry(view).center();
+        InputLatency::clearPending();
         NativeEventList events;
         events.append(new QNativeMouseButtonEvent(viewCenter, Qt::LeftButton, 1, Qt::NoModifier));
         events.append(new QNativeMouseButtonEvent(viewCenter, Qt::LeftButton, 0, Qt::NoModifier));
@@ -1238,7 +1275,8 @@ void tst_QCocoaWindow::nativeMouseEvents()
     }
 }
 
-// Verify that key event generation and processing works as expected for native views.
+// Verify that key event generation and processing works as expected for native
+// views. Delivery latency is collected by InputLatency.
 void tst_QCocoaWindow::nativeKeyboardEvents()
 {
 #ifndef HAVE_WORKING_CGEVENTPOST
@@ -1254,6 +1292,7 @@ void tst_QCocoaWindow::nativeKeyboardEvents()
 
         WAIT
 
+        InputLatency::clearPending();
         NativeEventList events;
         events.append(new QNativeKeyEvent(QNativeKeyEvent::Key_A, true, Qt::NoModifier));
         events.append(new QNativeKeyEvent(QNativeKeyEvent::Key_A, false, Qt::NoModifier));
@@ -1339,26 +1378,313 @@ void tst_QCocoaWindow::nativeEventForwarding()
 }
 
 
+static bool sameNativeEvent(const QNativeEvent *a, const QNativeEvent *b)
+{
+    if (!a || !b || a->id() != b->id() || a->modifiers != b->modifiers)
+        return false;
+
+    switch (a->id()) {
+        case QNativeMouseMoveEvent::eventId:
+            return static_cast<const QNativeMouseEvent *>(a)->globalPos
+                == static_cast<const QNativeMouseEvent *>(b)->globalPos;
+        case QNativeMouseButtonEvent::eventId:
+        case QNativeMouseDragEvent::eventId: {
+            const QNativeMouseButtonEvent *ea = static_cast<const QNativeMouseButtonEvent *>(a);
+            const QNativeMouseButtonEvent *eb = static_cast<const QNativeMouseButtonEvent *>(b);
+            return ea->globalPos == eb->globalPos && ea->button == eb->button
+                && ea->clickCount == eb->clickCount; }
+        case QNativeMouseWheelEvent::eventId: {
+            const QNativeMouseWheelEvent *ea = static_cast<const QNativeMouseWheelEvent *>(a);
+            const QNativeMouseWheelEvent *eb = static_cast<const QNativeMouseWheelEvent *>(b);
+            return ea->globalPos == eb->globalPos && ea->delta == eb->delta; }
+        case QNativeKeyEvent::eventId: {
+            const QNativeKeyEvent *ea = static_cast<const QNativeKeyEvent *>(a);
+            const QNativeKeyEvent *eb = static_cast<const QNativeKeyEvent *>(b);
+            return ea->nativeKeyCode == eb->nativeKeyCode && ea->press == eb->press
+                && ea->character == eb->character; }
+        case QNativeModifierEvent::eventId:
+            return static_cast<const QNativeModifierEvent *>(a)->nativeKeyCode
+                == static_cast<const QNativeModifierEvent *>(b)->nativeKeyCode;
+        default:
+            return false;
+    }
+}
+
+// Verify that every QNativeEvent subtype survives a QNativeEventStream
+// write/read round trip, and that truncated streams are detected.
+void tst_QCocoaWindow::nativeEventStream()
+{
+    QNativeMouseMoveEvent move(QPoint(100, 200), Qt::ShiftModifier);
+    QNativeMouseButtonEvent press(QPoint(90, 210), Qt::LeftButton, 1);
+    QNativeMouseButtonEvent release(QPoint(-5, 3), Qt::RightButton, 0, Qt::ControlModifier);
+    QNativeMouseDragEvent drag(QPoint(70000, 40000), Qt::LeftButton);
+    QNativeMouseWheelEvent wheel(QPoint(0, 0), -120, Qt::AltModifier);
+    QNativeKeyEvent keyPress(0 /* kVK_ANSI_A */, true, QChar('a'), Qt::NoModifier);
+    QNativeKeyEvent keyRelease(0 /* kVK_ANSI_A */, false, QChar(0x00e6), Qt::MetaModifier);
+    QNativeModifierEvent modifier(Qt::ShiftModifier | Qt::ControlModifier, 56 /* kVK_Shift */);
+    const QNativeEvent *events[] = { &move, &press, &release, &drag, &wheel, &keyPress, &keyRelease, &modifier };
+    const int eventCount = sizeof(events) / sizeof(events[0]);
+    const qint64 timestamps[eventCount] = { 0, 1, 1000, 1000000, 5000000000LL, 5000000001LL, 5000000001LL, 9000000000LL };
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    {
+        QNativeEventStreamWriter writer(&buffer);
+        for (int i = 0; i < eventCount; ++i)
+            QVERIFY(writer.write(*events[i], timestamps[i]));
+        QVERIFY(writer.flush());
+        QVERIFY(!writer.hasError());
+    }
+    const QByteArray data = buffer.data();
+
+    // Round trip
+    {
+        QNativeEventStreamReader reader(data);
+        QVERIFY(reader.isValid());
+        QCOMPARE(reader.version(), int(QNativeEventStream::Version));
+        for (int i = 0; i < eventCount; ++i) {
+            qint64 timestamp = -1;
+            const QNativeEvent *event = reader.readNext(&timestamp);
+            QVERIFY2(sameNativeEvent(event, events[i]), qPrintable(events[i]->toString()));
+            QCOMPARE(timestamp, timestamps[i]);
+        }
+        QVERIFY(reader.atEnd());
+        QVERIFY(!reader.readNext());
+        QVERIFY(!reader.hasError());
+    }
+
+    // Truncated last record: the complete records are read, then an error.
+    {
+        QNativeEventStreamReader reader(data.left(data.size() - 1));
+        QVERIFY(reader.isValid());
+        for (int i = 0; i < eventCount - 1; ++i)
+            QVERIFY(sameNativeEvent(reader.readNext(), events[i]));
+        QVERIFY(!reader.readNext());
+        QVERIFY(reader.hasError());
+    }
+
+    // Truncated header
+    {
+        QTest::ignoreMessage(QtWarningMsg, "QNativeEventStreamReader: not a native event stream");
+        QNativeEventStreamReader reader(data.left(QNativeEventStream::HeaderSize - 1));
+        QVERIFY(!reader.isValid());
+        QVERIFY(!reader.readNext());
+    }
+
+    // Version 0 and versions newer than the reader are rejected.
+    const int badVersions[] = { 0, QNativeEventStream::Version + 1 };
+    for (int i = 0; i < int(sizeof(badVersions) / sizeof(badVersions[0])); ++i) {
+        const int badVersion = badVersions[i];
+        QByteArray badData = data;
+        qToLittleEndian<quint16>(badVersion, reinterpret_cast<uchar *>(badData.data()) + 4);
+        QTest::ignoreMessage(QtWarningMsg, qPrintable(QString("QNativeEventStreamReader: unsupported stream version %1").arg(badVersion)));
+        QNativeEventStreamReader reader(badData);
+        QVERIFY(!reader.isValid());
+        QVERIFY(!reader.readNext());
+    }
+}
+
+static qint64 totalWaitNs(const NativeEventList &list)
+{
+    qint64 total = 0;
+    for (int i = 0; i < list.count(); ++i)
+        total += list.waitNsAt(i);
+    return total;
+}
+
+static QPoint nativeEventPos(const QNativeEvent *event)
+{
+    return static_cast<const QNativeMouseEvent *>(event)->globalPos;
+}
+
+// Test that NativeEventCompactor coalesces within its budgets, drops
+// redundant modifier events and preserves the total playback time.
+void tst_QCocoaWindow::nativeEventCompactor()
+{
+    const qint64 ms = 1000000;
+
+    // Time budget: runs end when an event is more than 4 ms after the run start.
+    {
+        NativeEventList input;
+        for (int i = 0; i < 10; ++i)
+            input.appendNs(i ? ms : 0, QNativeMouseMoveEvent(QPoint(10, 10)));
+        NativeEventList output;
+        NativeEventCompactor compactor;
+        compactor.setTimeBudgetNs(4 * ms);
+        compactor.setDistanceBudget(100);
+        compactor.compact(input, &output);
+
+        QCOMPARE(compactor.inputCount(), 10);
+        QCOMPARE(compactor.outputCount(), 2);
+        QCOMPARE(output.count(), 2); // runs [0, 4] and [5, 9] ms, sent at their last event
+        QCOMPARE(output.waitNsAt(0), 4 * ms);
+        QCOMPARE(output.waitNsAt(1), 5 * ms);
+        QCOMPARE(totalWaitNs(output), totalWaitNs(input));
+    }
+
+    // Distance budget: runs end when an event is more than 5 pixels from the run start.
+    {
+        NativeEventList input;
+        for (int i = 0; i < 5; ++i)
+            input.appendNs(i ? ms : 0, QNativeMouseMoveEvent(QPoint(3 * i, 0)));
+        NativeEventList output;
+        NativeEventCompactor compactor;
+        compactor.setTimeBudgetNs(1000 * ms);
+        compactor.setDistanceBudget(5);
+        compactor.compact(input, &output);
+
+        QCOMPARE(output.count(), 3); // runs at x = [0, 3], [6, 9] and [12]
+        QCOMPARE(nativeEventPos(output.eventAt(0)), QPoint(3, 0));
+        QCOMPARE(nativeEventPos(output.eventAt(1)), QPoint(9, 0));
+        QCOMPARE(nativeEventPos(output.eventAt(2)), QPoint(12, 0));
+        QCOMPARE(totalWaitNs(output), totalWaitNs(input));
+    }
+
+    // Drags with different buttons, and moves and drags, are not coalesced.
+    {
+        NativeEventList input;
+        input.appendNs(0, QNativeMouseDragEvent(QPoint(0, 0), Qt::LeftButton));
+        input.appendNs(ms, QNativeMouseDragEvent(QPoint(1, 0), Qt::RightButton));
+        input.appendNs(ms, QNativeMouseMoveEvent(QPoint(2, 0)));
+        NativeEventList output;
+        NativeEventCompactor().compact(input, &output);
+        QCOMPARE(output.count(), 3);
+    }
+
+    // Trailing waits are kept, so the total playback time is unchanged.
+    {
+        NativeEventList input;
+        input.appendNs(0, QNativeMouseMoveEvent(QPoint(0, 0)));
+        input.appendNs(ms, QNativeMouseMoveEvent(QPoint(1, 0)));
+        input.appendNs(50 * ms);
+        NativeEventList output;
+        NativeEventCompactor().compact(input, &output);
+
+        QCOMPARE(output.count(), 2);
+        QVERIFY(output.eventAt(0));
+        QVERIFY(!output.eventAt(1));
+        QCOMPARE(output.waitNsAt(1), 50 * ms);
+        QCOMPARE(totalWaitNs(output), 51 * ms);
+    }
+
+    // Modifier events that don't change the modifier state are dropped; their
+    // waits carry over to the next event.
+    {
+        NativeEventList input;
+        input.appendNs(0, QNativeModifierEvent(Qt::NoModifier));
+        input.appendNs(ms, QNativeModifierEvent(Qt::ShiftModifier));
+        input.appendNs(ms, QNativeModifierEvent(Qt::ShiftModifier));
+        input.appendNs(ms, QNativeModifierEvent(Qt::NoModifier));
+        input.appendNs(ms, QNativeModifierEvent(Qt::NoModifier));
+        NativeEventList output;
+        NativeEventCompactor().compact(input, &output);
+
+        QCOMPARE(output.count(), 3); // Shift, NoModifier and the trailing wait
+        QCOMPARE(output.eventAt(0)->modifiers, Qt::KeyboardModifiers(Qt::ShiftModifier));
+        QCOMPARE(output.waitNsAt(0), ms);
+        QCOMPARE(output.eventAt(1)->modifiers, Qt::KeyboardModifiers(Qt::NoModifier));
+        QCOMPARE(output.waitNsAt(1), 2 * ms);
+        QVERIFY(!output.eventAt(2));
+        QCOMPARE(totalWaitNs(output), totalWaitNs(input));
+    }
+}
+
+// Test the event counts and intervals of the NativeEventGenerator streams.
+void tst_QCocoaWindow::nativeEventGenerator()
+{
+    // 1000 Hz for 10 ms: the start position and 10 steps.
+    {
+        NativeEventList list;
+        NativeEventGenerator::mouseMoves(&list, QPoint(0, 0), QPoint(100, 0), 1000, 10);
+        QCOMPARE(list.count(), 11);
+        QCOMPARE(list.waitNsAt(0), qint64(0));
+        for (int i = 1; i < list.count(); ++i)
+            QCOMPARE(list.waitNsAt(i), qint64(1000000));
+        QCOMPARE(list.eventAt(0)->id(), int(QNativeMouseMoveEvent::eventId));
+        QCOMPARE(nativeEventPos(list.eventAt(0)), QPoint(0, 0));
+        QCOMPARE(nativeEventPos(list.eventAt(5)), QPoint(50, 0));
+        QCOMPARE(nativeEventPos(list.eventAt(10)), QPoint(100, 0));
+    }
+
+    // 2000 Hz for 5 ms: press, 10 drag steps and release.
+    {
+        NativeEventList list;
+        NativeEventGenerator::mouseDrag(&list, QPoint(0, 0), QPoint(0, 20), 2000, 5, Qt::RightButton);
+        QCOMPARE(list.count(), 12);
+        QCOMPARE(list.waitNsAt(0), qint64(0));
+        for (int i = 1; i < list.count(); ++i)
+            QCOMPARE(list.waitNsAt(i), qint64(500000));
+        const QNativeMouseButtonEvent *press = static_cast<const QNativeMouseButtonEvent *>(list.eventAt(0));
+        QCOMPARE(press->id(), int(QNativeMouseButtonEvent::eventId));
+        QCOMPARE(press->clickCount, 1);
+        QCOMPARE(press->button, Qt::RightButton);
+        for (int i = 1; i <= 10; ++i)
+            QCOMPARE(list.eventAt(i)->id(), int(QNativeMouseDragEvent::eventId));
+        const QNativeMouseButtonEvent *release = static_cast<const QNativeMouseButtonEvent *>(list.eventAt(11));
+        QCOMPARE(release->id(), int(QNativeMouseButtonEvent::eventId));
+        QCOMPARE(release->clickCount, 0);
+        QCOMPARE(release->globalPos, QPoint(0, 20));
+    }
+
+    // 5 presses at 3000 Hz and a release, with sub-millisecond intervals.
+    {
+        NativeEventList list;
+        NativeEventGenerator::keyRepeat(&list, 0 /* kVK_ANSI_A */, QChar('a'), 3000, 5, Qt::ShiftModifier);
+        QCOMPARE(list.count(), 6);
+        QCOMPARE(list.waitNsAt(0), qint64(0));
+        for (int i = 1; i < list.count(); ++i)
+            QCOMPARE(list.waitNsAt(i), qint64(333333));
+        for (int i = 0; i < list.count(); ++i) {
+            const QNativeKeyEvent *key = static_cast<const QNativeKeyEvent *>(list.eventAt(i));
+            QCOMPARE(key->id(), int(QNativeKeyEvent::eventId));
+            QCOMPARE(key->press, i < 5);
+            QCOMPARE(key->modifiers, Qt::KeyboardModifiers(Qt::ShiftModifier));
+        }
+    }
+
+    // 4 wheel events at 120 Hz.
+    {
+        NativeEventList list;
+        NativeEventGenerator::wheelBurst(&list, QPoint(5, 5), -1, 120, 4);
+        QCOMPARE(list.count(), 4);
+        QCOMPARE(list.waitNsAt(0), qint64(0));
+        for (int i = 1; i < list.count(); ++i)
+            QCOMPARE(list.waitNsAt(i), qint64(8333333));
+        QCOMPARE(static_cast<const QNativeMouseWheelEvent *>(list.eventAt(3))->delta, -1);
+    }
+}
+
+void tst_QCocoaWindow::mouseEvents_data()
+{
+    QTest::addColumn<TestWindow::WindowConfiguration>("windowconfiguration");
+    WINDOW_CONFIGS {
+        QTest::newRow(TestWindow::windowConfigurationName(WINDOW_CONFIG).constData()) << WINDOW_CONFIG;
+    }
+}
+
+// Verify that mouse event generation and processing works as expected for
+// QWindow. Delivery latency is collected by InputLatency.
 void tst_QCocoaWindow::mouseEvents()
 {
 #ifndef HAVE_WORKING_CGEVENTPOST
     QSKIP("This test requires CGEventPost");
 #endif
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+
     LOOP {
-        TestWindow *window = TestWindow::createWindow();
+        TestWindow *window = TestWindow::createWindow(windowconfiguration);
         window->setGeometry(100, 100, 100, 100);
         window->show();
-
-        WAIT
+        waitForWindowVisible(window);
 
         QPoint viewCenter = screenGeometry(window).center();
+        InputLatency::clearPending();
         NativeEventList events;
+        events.setBackPressureTarget(window->qwindow()); // play() returns on delivery
         events.append(new QNativeMouseButtonEvent(viewCenter, Qt::LeftButton, 1, Qt::NoModifier));
         events.append(new QNativeMouseButtonEvent(viewCenter, Qt::LeftButton, 0, Qt::NoModifier));
         events.play();
 
-        WAIT
-
         QVERIFY(window->takeOneEvent(TestWindow::MouseDownEvent));
         QVERIFY(window->takeOneEvent(TestWindow::MouseUpEvent));
 
@@ -1366,26 +1692,36 @@ void tst_QCocoaWindow::mouseEvents()
     }
 }
 
-// Verify that key event generation and processing works as expected for native views.
+void tst_QCocoaWindow::keyboardEvents_data()
+{
+    QTest::addColumn<TestWindow::WindowConfiguration>("windowconfiguration");
+    WINDOW_CONFIGS {
+        QTest::newRow(TestWindow::windowConfigurationName(WINDOW_CONFIG).constData()) << WINDOW_CONFIG;
+    }
+}
+
+// Verify that key event generation and processing works as expected for
+// QWindow. Delivery latency is collected by InputLatency.
 void tst_QCocoaWindow::keyboardEvents()
 {
 #ifndef HAVE_WORKING_CGEVENTPOST
     QSKIP("This test requires CGEventPost");
 #endif
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+
     LOOP {
-        TestWindow *window = TestWindow::createWindow();
+        TestWindow *window = TestWindow::createWindow(windowconfiguration);
         window->setGeometry(100, 100, 100, 100);
         window->show();
+        waitForWindowVisible(window);
 
-        WAIT
-
+        InputLatency::clearPending();
         NativeEventList events;
+        events.setBackPressureTarget(window->qwindow()); // play() returns on delivery
         events.append(new QNativeKeyEvent(QNativeKeyEvent::Key_A, true, Qt::NoModifier));
         events.append(new QNativeKeyEvent(QNativeKeyEvent::Key_A, false, Qt::NoModifier));
         events.play();
 
-        WAIT
-
         QVERIFY(window->takeOneEvent(TestWindow::KeyDownEvent));
         QVERIFY(window->takeOneEvent(TestWindow::KeyUpEvent));
 
@@ -1693,8 +2029,10 @@ void tst_QCocoaWindow::expose()
 
         // Show the window, expect one expose and one paint event.
         window->show();
-        WAIT WAIT  WAIT WAIT
+        window->waitForEvent(TestWindow::PaintEvent);
 
+        // The paint follows the expose.
+        QVERIFY(window->trace().intervalNs(TestWindow::ExposeEvent, TestWindow::PaintEvent) >= 0);
         QVERIFY(window->takeOneEvent(TestWindow::ExposeEvent));
         QVERIFY(!window->takeOneEvent(TestWindow::ObscureEvent));
         QVERIFY(window->takeOneEvent(TestWindow::PaintEvent));
@@ -1716,7 +2054,7 @@ void tst_QCocoaWindow::expose()
 
         // Show the window, expect one expose event
         window->show();
-        WAIT WAIT
+        window->waitForEvent(TestWindow::PaintEvent);
         QVERIFY(window->takeOneEvent(TestWindow::ExposeEvent));
         QVERIFY(!window->takeOneEvent(TestWindow::ObscureEvent));
 
@@ -1771,7 +2109,10 @@ void tst_QCocoaWindow::expose_child()
         // be omitted if there is cached content.
         child->show();
         parent->show();
-        WAIT
+        parent->waitForEvent(TestWindow::PaintEvent);
+        child->waitForEvent(TestWindow::ExposeEvent);
+        // The child paint may be skipped (see QEXPECT_FAIL below); don't wait long for it.
+        child->waitForEvent(TestWindow::PaintEvent, 1, 200);
         QVERIFY(parent->takeOneEvent(TestWindow::ExposeEvent));
         QVERIFY(parent->takeOneEvent(TestWindow::PaintEvent));
 #if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
@@ -1782,13 +2123,14 @@ void tst_QCocoaWindow::expose_child()
 
         // Hide and test for obscure events
         parent->hide();
-        WAIT
+        parent->waitForEvent(TestWindow::ObscureEvent);
+        child->waitForEvent(TestWindow::ObscureEvent);
         QVERIFY(parent->takeOneEvent(TestWindow::ObscureEvent));
         QVERIFY(child->takeOneEvent(TestWindow::ObscureEvent));
 
         // Re-show and test for expose/paint
         parent->show();
-        WAIT
+        parent->waitForEvent(TestWindow::PaintEvent);
         QVERIFY(parent->takeOneEvent(TestWindow::ExposeEvent));
         QVERIFY(parent->takeOneEvent(TestWindow::PaintEvent));
 //    ### TODO
@@ -1820,14 +2162,14 @@ void tst_QCocoaWindow::expose_resize()
         QRect geometry(100, 100, 100, 100);
         window->setGeometry(geometry);
         window->show();
-        WAIT WAIT WAIT // wait-for-painted
+        waitForWindowVisible(window);
 
         // Resize using QWindow API
         {
             window->resetCounters();
             QRect geometry(100, 100, 150, 150);
             window->setGeometry(geometry);
-            WAIT
+            window->waitForEvent(TestWindow::PaintEvent);
             QVERIFY(window->takeOneEvent(TestWindow::ExposeEvent));
             QVERIFY(window->takeOneEvent(TestWindow::PaintEvent));
         }
@@ -1839,7 +2181,7 @@ void tst_QCocoaWindow::expose_resize()
             QRect geometry(100, 100, 200, 200);
             NSRect frame = nswindowFrameGeometry(geometry, nswindow);
             [nswindow setFrame:frame display:NO animate:NO];
-            WAIT
+            window->waitForEvent(TestWindow::PaintEvent);
             QVERIFY(window->takeOneEvent(TestWindow::ExposeEvent));
             QVERIFY(window->takeOneEvent(TestWindow::PaintEvent));
         }
@@ -1852,7 +2194,8 @@ void tst_QCocoaWindow::expose_resize()
             NSRect frame = nswindowFrameGeometry(geometry, nswindow);
             [nswindow setFrame:frame display:YES animate:NO];
             // WAIT not needed due to immediate display.
-            WAIT // ### Event loop sping actually needed on 10.12 Beta
+            // ### Event loop sping actually needed on 10.12 Beta
+            window->waitForEvent(TestWindow::PaintEvent);
             QVERIFY(window->takeOneEvent(TestWindow::ExposeEvent));
             QVERIFY(window->takeOneEvent(TestWindow::PaintEvent));
         }
@@ -1914,7 +2257,7 @@ void tst_QCocoaWindow::requestUpdate()
         for (int i = 0; i < 5; ++i) {
             window->resetCounters();
             window->requestUpdate();
-            WAIT
+            window->waitForEvent(TestWindow::PaintEvent);
             QVERIFY(window->takeOneOrManyEvents(TestWindow::PaintEvent));
             // TODO: Be stricter and expect one paint event only?
         }
@@ -2099,9 +2442,9 @@ void tst_QCocoaWindow::paint_coverage()
         window->show();
         WAIT WAIT
 
-        // Verify that the pixels on screen match
+        // Verify that the window content matches
         QRect imageGeometry(QPoint(0, 0), geometry.size());
-        QVERIFY(verifyImage(grabWindow(window), imageGeometry, toQColor(FILLER_COLOR)));
+        QVERIFY(verifyImage(window->grabContent(), imageGeometry, toQColor(FILLER_COLOR)));
 
         // Fill subrect with new color
         window->setFillColor(toQColor(OK_COLOR));
@@ -2110,20 +2453,24 @@ void tst_QCocoaWindow::paint_coverage()
         WAIT WAIT
 
         // Verify that the window was partially repainted
-        QVERIFY(verifyImage(grabWindow(window), updateRect, toQColor(OK_COLOR)));
+        QVERIFY(verifyImage(window->grabContent(), updateRect, toQColor(OK_COLOR)));
         QRect notUpdated(110, 110, 50, 50);
 #if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
         QEXPECT_FAIL("", "paint_coverage test is broken on 5.8", Abort);
 #endif
-        QVERIFY(verifyImage(grabWindow(window), notUpdated, toQColor(FILLER_COLOR)));
+        QVERIFY(verifyImage(window->grabContent(), notUpdated, toQColor(FILLER_COLOR)));
+        QImage partialUpdate = window->grabContent();
 
 #ifdef HAVE_QPAINTDEVICEWINDOW_REPAINT
         // Call repaint() and verify that the window has been repainted on return.
         window->repaint();
-        QVERIFY(verifyImage(grabWindow(window), imageGeometry, toQColor(OK_COLOR)));
+        QVERIFY(verifyImage(window->grabContent(), imageGeometry, toQColor(OK_COLOR)));
 #endif
         delete window;
         WAIT
+
+        // Last, since a missing reference skips the rest of the test.
+        QVERIFY_GOLDEN(partialUpdate, windowconfiguration, "partial_update");
     }
 }
 
@@ -0,0 +1,223 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include "testsupport.h"
+
+// Frame pacing for continuously updating windows: update() for raster,
+// requestUpdate() for OpenGL, both paced by UpdateRequest. Each window
+// paints continuously for FRAMEPACING_DURATION milliseconds (default 3000) while
+// TestWindowTrace records the paint timestamps. Reports achieved FPS, the
+// frame interval percentiles, missed frames and the longest stall, for
+// each window configuration and for both update drivers. glContent
+// repeats this for OpenGL windows drawing 1 to 1M triangles with the
+// core profile GLContentRenderer, and workload sweeps the Workload
+// complexity levels (seeded with FRAMEPACING_SEED, default 1) and
+// reports the first level where each configuration drops below 60 fps.
+// The benchmark result is the achieved FPS.
+//
+// The trace holds TestWindowTrace::Capacity events, which covers the
+// default duration at up to ~300 fps.
+
+class tst_bench_framepacing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase_data();
+    void init();
+    void continuousUpdate_data();
+    void continuousUpdate();
+    void glContent_data();
+    void glContent();
+    void workload_data();
+    void workload();
+    void cleanupTestCase();
+
+private:
+    void measure(TestWindow *window, qreal *fps = 0);
+
+    QMap<QByteArray, QMap<int, qreal> > workloadFps; // configuration -> level -> fps
+};
+
+void tst_bench_framepacing::initTestCase_data()
+{
+    QTest::addColumn<bool>("displaylink");
+#ifdef HAVE_CVDISPLAYLINK
+    QTest::newRow("displaylink_update") << true;
+#endif
+    QTest::newRow("timer_update") << false;
+}
+
+void tst_bench_framepacing::init()
+{
+    QFETCH_GLOBAL(bool, displaylink);
+    qputenv("QT_MAC_ENABLE_CVDISPLAYLINK", displaylink ? QByteArray("1") : QByteArray("0"));
+}
+
+void tst_bench_framepacing::continuousUpdate_data()
+{
+    QTest::addColumn<TestWindow::WindowConfiguration>("windowconfiguration");
+    WINDOW_CONFIGS {
+        QTest::newRow(TestWindow::windowConfigurationName(WINDOW_CONFIG).constData()) << WINDOW_CONFIG;
+    }
+}
+
+void tst_bench_framepacing::continuousUpdate()
+{
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+    measure(TestWindow::createWindow(windowconfiguration));
+}
+
+void tst_bench_framepacing::glContent_data()
+{
+    QTest::addColumn<TestWindow::WindowConfiguration>("windowconfiguration");
+    QTest::addColumn<int>("triangleCount");
+    WINDOW_CONFIGS {
+        if (TestWindow::isRasterWindow(WINDOW_CONFIG))
+            continue;
+        for (int count = 1; count <= GLContentRenderer::MaxTriangleCount; count *= 100) {
+            QByteArray name = TestWindow::windowConfigurationName(WINDOW_CONFIG) + "_" + QByteArray::number(count);
+            QTest::newRow(name.constData()) << WINDOW_CONFIG << count;
+        }
+    }
+}
+
+// Frame pacing under GL load: the window draws triangleCount triangles
+// with the core profile renderer.
+void tst_bench_framepacing::glContent()
+{
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+    QFETCH(int, triangleCount);
+
+    TestWindow *window = TestWindow::createWindow(windowconfiguration);
+    window->setGLContent(triangleCount);
+    measure(window);
+}
+
+void tst_bench_framepacing::workload_data()
+{
+    QTest::addColumn<TestWindow::WindowConfiguration>("windowconfiguration");
+    QTest::addColumn<int>("level");
+    WINDOW_CONFIGS {
+        for (int level = 0; level <= 8; ++level) {
+            QByteArray name = TestWindow::windowConfigurationName(WINDOW_CONFIG) + "_level" + QByteArray::number(level);
+            QTest::newRow(name.constData()) << WINDOW_CONFIG << level;
+        }
+    }
+}
+
+// Frame pacing with a Workload of increasing complexity.
+void tst_bench_framepacing::workload()
+{
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+    QFETCH(int, level);
+
+    quint32 seed = qEnvironmentVariableIsSet("FRAMEPACING_SEED")
+                 ? quint32(qEnvironmentVariableIntValue("FRAMEPACING_SEED")) : 1;
+    WorkloadParameters parameters = WorkloadParameters::level(level, seed);
+    qDebug() << qPrintable(parameters.toString());
+
+    TestWindow *window = TestWindow::createWindow(windowconfiguration);
+    window->setWorkload(parameters);
+    qreal fps = 0;
+    measure(window, &fps);
+
+    QByteArray key = TestWindow::windowConfigurationName(windowconfiguration);
+    QFETCH_GLOBAL(bool, displaylink);
+    key += displaylink ? " (displaylink)" : " (timer)";
+    workloadFps[key][level] = fps;
+}
+
+void tst_bench_framepacing::cleanupTestCase()
+{
+    for (auto it = workloadFps.constBegin(); it != workloadFps.constEnd(); ++it) {
+        int firstSlow = -1;
+        for (auto level = it.value().constBegin(); level != it.value().constEnd(); ++level) {
+            if (level.value() < 60) {
+                firstSlow = level.key();
+                break;
+            }
+        }
+        if (firstSlow < 0)
+            qDebug() << qPrintable(QString("%1: 60 fps at all workload levels").arg(QString(it.key())));
+        else
+            qDebug() << qPrintable(QString("%1: below 60 fps from workload level %2 (%3 fps)")
+                .arg(QString(it.key())).arg(firstSlow).arg(it.value().value(firstSlow), 0, 'f', 1));
+    }
+}
+
+// Shows the window, animates it and reports the frame statistics. Deletes the window.
+void tst_bench_framepacing::measure(TestWindow *window, qreal *fps)
+{
+    int durationMs = qEnvironmentVariableIsSet("FRAMEPACING_DURATION")
+                   ? qEnvironmentVariableIntValue("FRAMEPACING_DURATION") : 3000;
+
+    window->setGeometry(QRect(100, 100, 400, 300));
+    window->show();
+    waitForWindowVisible(window);
+
+    // Skip startup frames, they include the initial expose.
+    window->setContinuousUpdate(true);
+    QTest::qWait(200);
+
+    qint64 startNs = QNativeInput::monotonicNs();
+    QTest::qWait(durationMs);
+    window->setContinuousUpdate(false);
+
+    QVector<qint64> intervals;
+    const TestWindowTrace &trace = window->trace();
+    qint64 lastPaintNs = -1;
+    for (int i = 0; i < trace.count(); ++i) {
+        const TestWindowTraceEvent &event = trace.at(i);
+        if (event.type != TestWindow::PaintEvent || event.timestampNs < startNs)
+            continue;
+        if (lastPaintNs >= 0)
+            intervals.append(event.timestampNs - lastPaintNs);
+        lastPaintNs = event.timestampNs;
+    }
+
+    QScreen *screen = window->qwindow()->screen();
+    qreal refreshRate = screen ? screen->refreshRate() : 60;
+    delete window;
+
+    QVERIFY2(!intervals.isEmpty(), "no frames were painted");
+    FrameStatistics stats = FrameStatistics::fromIntervals(intervals, refreshRate);
+    qDebug() << qPrintable(QString("%1 Hz display: ").arg(refreshRate) + stats.toString());
+    QTest::setBenchmarkResult(stats.fps, QTest::FramesPerSecond);
+    if (fps)
+        *fps = stats.fps;
+}
+
+QTEST_MAIN(tst_bench_framepacing)
+#include "tst_bench_framepacing.moc"
@@ -0,0 +1,24 @@
+TEMPLATE = app
+TARGET = tst_bench_glthreading
+
+QT = core gui testlib
+CONFIG += c++11
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+# testbench OpenGL windows
+TESTBENCH = $$PWD/../../manual/testbench
+INCLUDEPATH += $$TESTBENCH
+HEADERS += \
+    $$TESTBENCH/glcontent.h \
+    $$TESTBENCH/openglwindow.h \
+    $$TESTBENCH/threadedopenglwindow.h \
+    $$TESTBENCH/workload.h
+SOURCES += \
+    $$TESTBENCH/glcontent.cpp \
+    $$TESTBENCH/openglwindow.cpp \
+    $$TESTBENCH/threadedopenglwindow.cpp \
+    $$TESTBENCH/workload.cpp
+
+SOURCES += tst_bench_glthreading.cpp
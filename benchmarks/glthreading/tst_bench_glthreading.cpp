@@ -0,0 +1,148 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <algorithm>
+#include <cmath>
+
+#include "openglwindow.h"
+#include "threadedopenglwindow.h"
+
+// GUI thread stalls with N animating OpenGL windows, rendering on the GUI
+// thread (OpenGLWindow) versus on a render thread per window
+// (ThreadedOpenGLWindow). A 1 ms precise timer on the GUI thread probes
+// for GLTHREADING_DURATION milliseconds (default 3000); a stall is how
+// late a timer tick is. Reports the stall distribution and the aggregate
+// frame rate. The benchmark result is the 99th percentile stall.
+
+bool g_animate = true; // read by the testbench OpenGL content
+
+class tst_bench_glthreading : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void stalls_data();
+    void stalls();
+};
+
+void tst_bench_glthreading::stalls_data()
+{
+    QTest::addColumn<bool>("threaded");
+    QTest::addColumn<int>("windowCount");
+    for (int count = 1; count <= 16; count *= 4) {
+        QByteArray suffix = '_' + QByteArray::number(count);
+        QTest::newRow(("gui_thread" + suffix).constData()) << false << count;
+        QTest::newRow(("render_thread" + suffix).constData()) << true << count;
+    }
+}
+
+void tst_bench_glthreading::stalls()
+{
+    QFETCH(bool, threaded);
+    QFETCH(int, windowCount);
+
+    int durationMs = qEnvironmentVariableIsSet("GLTHREADING_DURATION")
+                   ? qEnvironmentVariableIntValue("GLTHREADING_DURATION") : 3000;
+
+    QList<QWindow *> windows;
+    QAtomicInt guiThreadFrames;
+    for (int i = 0; i < windowCount; ++i) {
+        QWindow *window;
+        if (threaded) {
+            window = new ThreadedOpenGLWindow();
+        } else {
+            OpenGLWindow *openglWindow = new OpenGLWindow();
+            connect(openglWindow, &QOpenGLWindow::frameSwapped, [&guiThreadFrames]() { guiThreadFrames.ref(); });
+            window = openglWindow;
+        }
+        window->setGeometry(QRect(QPoint(20 + (i % 4) * 210, 40 + (i / 4) * 170), QSize(200, 160)));
+        window->show();
+        windows.append(window);
+    }
+    QTest::qWait(500);
+
+    auto frameCount = [&]() {
+        int frames = guiThreadFrames.load();
+        if (threaded) {
+            foreach (QWindow *window, windows)
+                frames += static_cast<ThreadedOpenGLWindow *>(window)->frameCount();
+        }
+        return frames;
+    };
+
+    // Probe the GUI thread.
+    QVector<qint64> stalls;
+    QElapsedTimer clock;
+    qint64 lastTickNs = 0;
+    QTimer probe;
+    probe.setTimerType(Qt::PreciseTimer);
+    probe.setInterval(1);
+    connect(&probe, &QTimer::timeout, [&]() {
+        qint64 nowNs = clock.nsecsElapsed();
+        stalls.append(qMax<qint64>(0, nowNs - lastTickNs - 1000000));
+        lastTickNs = nowNs;
+    });
+
+    int startFrames = frameCount();
+    clock.start();
+    probe.start();
+    QTest::qWait(durationMs);
+    probe.stop();
+    qint64 elapsedNs = clock.nsecsElapsed();
+    int frames = frameCount() - startFrames;
+
+    qDeleteAll(windows);
+
+    QVERIFY2(!stalls.isEmpty(), "the probe timer did not fire");
+    std::sort(stalls.begin(), stalls.end());
+    qint64 totalStallNs = 0;
+    foreach (qint64 stall, stalls)
+        totalStallNs += stall;
+    auto percentileMs = [&stalls](int percentile) {
+        int rank = qMax(1, int(std::ceil(percentile / 100.0 * stalls.size())));
+        return stalls.at(qMin(rank, stalls.size()) - 1) / 1e6;
+    };
+
+    qDebug() << qPrintable(QString("%1 windows, %2: %3 fps aggregate, GUI thread stall p50 %4 ms "
+                                   "p99 %5 ms max %6 ms, %7% of the time stalled")
+        .arg(windowCount).arg(threaded ? "render thread" : "GUI thread")
+        .arg(frames / (elapsedNs / 1e9), 0, 'f', 1)
+        .arg(percentileMs(50), 0, 'f', 2).arg(percentileMs(99), 0, 'f', 2)
+        .arg(stalls.last() / 1e6, 0, 'f', 2)
+        .arg(100.0 * totalStallNs / elapsedNs, 0, 'f', 1));
+    QTest::setBenchmarkResult(percentileMs(99), QTest::WalltimeMilliseconds);
+}
+
+QTEST_MAIN(tst_bench_glthreading)
+#include "tst_bench_glthreading.moc"
@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = tst_bench_nativeeventdispatch
+
+QT = core testlib
+CONFIG += c++11
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+include($$PWD/../../auto/qcocoawindow/nativeevents/nativeevents.pri)
+
+SOURCES += tst_bench_nativeeventdispatch.cpp
@@ -0,0 +1,228 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QTest>
+#include <qnativeevents.h>
+#include <qnativeeventvariant.h>
+
+// Compares dispatching native events through the polymorphic QNativeEvent
+// classes (virtual id() + static_cast, virtual QNativeInput callbacks) with
+// dispatching through QNativeEventVariant (compile-time visit, non-virtual
+// handlers). Each benchmark iteration dispatches dispatchCount events from
+// a pool of synthetic events of mixed types.
+
+static const int dispatchCount = 20 * 1000 * 1000;
+static const int poolSize = 1024; // power of two
+
+// Subscriber using the virtual QNativeInput callbacks.
+class CountingInput : public QNativeInput
+{
+public:
+    CountingInput() : QNativeInput(false), count(0), sum(0) {}
+
+    void nativeMousePressEvent(QNativeMouseButtonEvent *e) Q_DECL_OVERRIDE { ++count; sum += e->globalPos.x(); }
+    void nativeMouseReleaseEvent(QNativeMouseButtonEvent *e) Q_DECL_OVERRIDE { ++count; sum += e->globalPos.y(); }
+    void nativeMouseMoveEvent(QNativeMouseMoveEvent *e) Q_DECL_OVERRIDE { ++count; sum += e->globalPos.x(); }
+    void nativeMouseDragEvent(QNativeMouseDragEvent *e) Q_DECL_OVERRIDE { ++count; sum += e->globalPos.y(); }
+    void nativeMouseWheelEvent(QNativeMouseWheelEvent *e) Q_DECL_OVERRIDE { ++count; sum += e->delta; }
+    void nativeKeyPressEvent(QNativeKeyEvent *e) Q_DECL_OVERRIDE { ++count; sum += e->nativeKeyCode; }
+    void nativeKeyReleaseEvent(QNativeKeyEvent *e) Q_DECL_OVERRIDE { ++count; sum -= e->nativeKeyCode; }
+    void nativeModifierEvent(QNativeModifierEvent *e) Q_DECL_OVERRIDE { ++count; sum += e->nativeKeyCode; }
+
+    qint64 count;
+    qint64 sum;
+};
+
+// Subscriber for qDispatchNativeEvent(): the same work, bound statically.
+class CountingHandler
+{
+public:
+    CountingHandler() : count(0), sum(0) {}
+
+    void nativeMousePressEvent(const QNativeMouseButtonEvent &e) { ++count; sum += e.globalPos.x(); }
+    void nativeMouseReleaseEvent(const QNativeMouseButtonEvent &e) { ++count; sum += e.globalPos.y(); }
+    void nativeMouseMoveEvent(const QNativeMouseMoveEvent &e) { ++count; sum += e.globalPos.x(); }
+    void nativeMouseDragEvent(const QNativeMouseDragEvent &e) { ++count; sum += e.globalPos.y(); }
+    void nativeMouseWheelEvent(const QNativeMouseWheelEvent &e) { ++count; sum += e.delta; }
+    void nativeKeyPressEvent(const QNativeKeyEvent &e) { ++count; sum += e.nativeKeyCode; }
+    void nativeKeyReleaseEvent(const QNativeKeyEvent &e) { ++count; sum -= e.nativeKeyCode; }
+    void nativeModifierEvent(const QNativeModifierEvent &e) { ++count; sum += e.nativeKeyCode; }
+
+    qint64 count;
+    qint64 sum;
+};
+
+// Stand-in for the platform send functions, so that the sender benchmarks
+// measure dispatch and not CGEventPost.
+struct CountingSink
+{
+    CountingSink() : count(0) {}
+    Qt::Native::Status send(const QNativeEvent &) { ++count; return Qt::Native::Success; }
+    qint64 count;
+};
+
+// Mirrors QNativeInput::sendNativeEvent(): switch on the virtual id() and downcast.
+static Qt::Native::Status sendVirtual(const QNativeEvent &event, CountingSink &sink)
+{
+    switch (event.id()){
+        case QNativeMouseMoveEvent::eventId:
+            return sink.send(static_cast<const QNativeMouseMoveEvent &>(event));
+        case QNativeMouseButtonEvent::eventId:
+            return sink.send(static_cast<const QNativeMouseButtonEvent &>(event));
+        case QNativeMouseDragEvent::eventId:
+            return sink.send(static_cast<const QNativeMouseDragEvent &>(event));
+        case QNativeMouseWheelEvent::eventId:
+            return sink.send(static_cast<const QNativeMouseWheelEvent &>(event));
+        case QNativeKeyEvent::eventId:
+            return sink.send(static_cast<const QNativeKeyEvent &>(event));
+        case QNativeModifierEvent::eventId:
+            return sink.send(static_cast<const QNativeModifierEvent &>(event));
+        default:
+            return Qt::Native::Failure;
+    }
+}
+
+// Mirrors QNativeEventSender, with the same sink.
+struct SinkSender
+{
+    SinkSender(CountingSink &sink) : sink(sink) {}
+    template <typename T> Qt::Native::Status operator()(const T &e) const { return sink.send(e); }
+    CountingSink &sink;
+};
+
+class tst_bench_NativeEventDispatch : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void subscriber_data();
+    void subscriber();
+    void sender_data();
+    void sender();
+
+private:
+    QVector<QNativeEvent *> m_events;
+    QVector<QNativeEventVariant> m_variants;
+};
+
+void tst_bench_NativeEventDispatch::initTestCase()
+{
+    for (int i = 0; i < poolSize; ++i) {
+        QPoint pos(i % 640, i % 480);
+        QNativeEvent *event = 0;
+        switch (i % 8) {
+            case 0: event = new QNativeMouseMoveEvent(pos); break;
+            case 1: event = new QNativeMouseButtonEvent(pos, Qt::LeftButton, 1); break;
+            case 2: event = new QNativeMouseDragEvent(pos, Qt::LeftButton); break;
+            case 3: event = new QNativeMouseButtonEvent(pos, Qt::LeftButton, 0); break;
+            case 4: event = new QNativeMouseWheelEvent(pos, i % 7 - 3); break;
+            case 5: event = new QNativeKeyEvent(QNativeKeyEvent::Key_A, true); break;
+            case 6: event = new QNativeKeyEvent(QNativeKeyEvent::Key_A, false); break;
+            case 7: event = new QNativeModifierEvent(Qt::ShiftModifier, 56); break;
+        }
+        m_events.append(event);
+        m_variants.append(QNativeEventVariant::fromEvent(*event));
+    }
+}
+
+void tst_bench_NativeEventDispatch::cleanupTestCase()
+{
+    qDeleteAll(m_events);
+    m_events.clear();
+    m_variants.clear();
+}
+
+void tst_bench_NativeEventDispatch::subscriber_data()
+{
+    QTest::addColumn<bool>("variant");
+    QTest::newRow("virtual") << false;
+    QTest::newRow("variant") << true;
+}
+
+void tst_bench_NativeEventDispatch::subscriber()
+{
+    QFETCH(bool, variant);
+
+    qint64 count = 0;
+    if (variant) {
+        const QNativeEventVariant *events = m_variants.constData();
+        CountingHandler handler;
+        QBENCHMARK {
+            for (int i = 0; i < dispatchCount; ++i)
+                qDispatchNativeEvent(events[i & (poolSize - 1)], handler);
+        }
+        count = handler.count;
+    } else {
+        QNativeEvent * const *events = m_events.constData();
+        CountingInput input;
+        QBENCHMARK {
+            for (int i = 0; i < dispatchCount; ++i)
+                input.notify(events[i & (poolSize - 1)]);
+        }
+        count = input.count;
+    }
+
+    QVERIFY(count > 0 && count % dispatchCount == 0);
+}
+
+void tst_bench_NativeEventDispatch::sender_data()
+{
+    subscriber_data();
+}
+
+void tst_bench_NativeEventDispatch::sender()
+{
+    QFETCH(bool, variant);
+
+    CountingSink sink;
+    if (variant) {
+        const QNativeEventVariant *events = m_variants.constData();
+        QBENCHMARK {
+            for (int i = 0; i < dispatchCount; ++i)
+                events[i & (poolSize - 1)].visit(SinkSender(sink));
+        }
+    } else {
+        QNativeEvent * const *events = m_events.constData();
+        QBENCHMARK {
+            for (int i = 0; i < dispatchCount; ++i)
+                sendVirtual(*events[i & (poolSize - 1)], sink);
+        }
+    }
+
+    QVERIFY(sink.count > 0 && sink.count % dispatchCount == 0);
+}
+
+QTEST_MAIN(tst_bench_NativeEventDispatch)
+#include "tst_bench_nativeeventdispatch.moc"
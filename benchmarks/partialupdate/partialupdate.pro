@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = tst_bench_partialupdate
+
+QT = core gui widgets testlib
+CONFIG += c++11
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+# testbench RasterWindow
+TESTBENCH = $$PWD/../../manual/testbench
+INCLUDEPATH += $$TESTBENCH
+HEADERS += $$TESTBENCH/glcontent.h $$TESTBENCH/rasterwindow.h $$TESTBENCH/workload.h
+SOURCES += $$TESTBENCH/glcontent.cpp $$TESTBENCH/rasterwindow.cpp $$TESTBENCH/workload.cpp
+
+SOURCES += tst_bench_partialupdate.cpp
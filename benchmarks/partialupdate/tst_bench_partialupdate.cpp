@@ -0,0 +1,169 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include "rasterwindow.h"
+
+// Full versus partial repaint cost for the testbench RasterWindow, while
+// dragging its 40x40 rect across the window. For each window size and
+// update mode, PARTIALUPDATE_FRAMES (default 300) mouse moves are sent
+// and each resulting frame is timed:
+//
+//   - paint: time spent in RasterWindow::paintEvent()
+//   - frame: time spent handling the update request, including the flush
+//   - flushed bytes: size of the painted region in device pixels
+//
+// The benchmark result is the frame time. Set TESTBENCH_WORKLOAD to paint
+// a Workload in each frame.
+
+bool g_animate = false; // frames are driven by the mouse moves only
+
+class MeasuredRasterWindow : public RasterWindow
+{
+public:
+    MeasuredRasterWindow() : frames(0), paintNs(0), frameNs(0), paintedPixels(0) {}
+
+    bool event(QEvent *event) Q_DECL_OVERRIDE
+    {
+        if (event->type() != QEvent::UpdateRequest)
+            return RasterWindow::event(event);
+
+        QElapsedTimer timer;
+        timer.start();
+        bool result = RasterWindow::event(event);
+        frameNs += timer.nsecsElapsed();
+        ++frames;
+        return result;
+    }
+
+    int frames;
+    qint64 paintNs;
+    qint64 frameNs;
+    qint64 paintedPixels;
+
+protected:
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE
+    {
+        QElapsedTimer timer;
+        timer.start();
+        RasterWindow::paintEvent(event);
+        paintNs += timer.nsecsElapsed();
+        const QRegion &region = event->region();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+        for (QRegion::const_iterator it = region.begin(); it != region.end(); ++it)
+            paintedPixels += qint64(it->width()) * it->height();
+#else
+        foreach (const QRect &rect, region.rects())
+            paintedPixels += qint64(rect.width()) * rect.height();
+#endif
+    }
+};
+
+class tst_bench_partialupdate : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void drag_data();
+    void drag();
+};
+
+void tst_bench_partialupdate::drag_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<bool>("partial");
+
+    const QSize sizes[] = { QSize(200, 200), QSize(800, 600), QSize(1920, 1080), QSize(3840, 2160) };
+    for (const QSize &size : sizes) {
+        QByteArray name = QByteArray::number(size.width()) + 'x' + QByteArray::number(size.height());
+        QTest::newRow((name + "_full").constData()) << size << false;
+        QTest::newRow((name + "_partial").constData()) << size << true;
+    }
+}
+
+void tst_bench_partialupdate::drag()
+{
+    QFETCH(QSize, size);
+    QFETCH(bool, partial);
+
+    int frameCount = qEnvironmentVariableIsSet("PARTIALUPDATE_FRAMES")
+                   ? qMax(1, qEnvironmentVariableIntValue("PARTIALUPDATE_FRAMES")) : 300;
+
+    MeasuredRasterWindow window;
+    window.setPartialUpdate(partial);
+    window.setGeometry(QRect(QPoint(0, 0), size));
+    window.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&window));
+    QTest::qWait(100);
+
+    // The window may have been constrained to the screen.
+    QSize actualSize = window.size();
+    if (actualSize != size)
+        qWarning() << "Window is" << actualSize << "instead of" << size;
+
+    // Drag the rect back and forth along a line through the window.
+    QPoint start(30, actualSize.height() / 2);
+    QMouseEvent press(QEvent::MouseButtonPress, start, Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+    QCoreApplication::sendEvent(&window, &press);
+
+    window.frames = 0;
+    window.paintNs = window.frameNs = window.paintedPixels = 0;
+    int span = qMax(1, actualSize.width() - 60);
+    for (int i = 0; i < frameCount; ++i) {
+        int x = (i * 8) % (2 * span);
+        QPoint pos(30 + (x < span ? x : 2 * span - x), start.y());
+        QMouseEvent move(QEvent::MouseMove, pos, Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+        QCoreApplication::sendEvent(&window, &move);
+
+        // Wait for the frame.
+        QElapsedTimer timeout;
+        timeout.start();
+        while (window.frames <= i && timeout.elapsed() < 1000)
+            QCoreApplication::processEvents();
+        QVERIFY2(window.frames > i, "no frame after mouse move");
+    }
+
+    QMouseEvent release(QEvent::MouseButtonRelease, start, Qt::LeftButton, Qt::NoButton, Qt::NoModifier);
+    QCoreApplication::sendEvent(&window, &release);
+
+    qreal dpr = window.devicePixelRatio();
+    qreal frameMs = window.frameNs / 1e6 / window.frames;
+    qDebug() << qPrintable(QString("%1x%2 %3: paint %4 ms, frame %5 ms, %6 KB flushed per frame")
+        .arg(actualSize.width()).arg(actualSize.height()).arg(partial ? "partial" : "full")
+        .arg(window.paintNs / 1e6 / window.frames, 0, 'f', 3).arg(frameMs, 0, 'f', 3)
+        .arg(window.paintedPixels * 4 * dpr * dpr / 1024 / window.frames, 0, 'f', 1));
+    QTest::setBenchmarkResult(frameMs, QTest::WalltimeMilliseconds);
+}
+
+QTEST_MAIN(tst_bench_partialupdate)
+#include "tst_bench_partialupdate.moc"
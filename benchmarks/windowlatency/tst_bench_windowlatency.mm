@@ -0,0 +1,221 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <algorithm>
+#include <cmath>
+#include "testsupport.h"
+
+// Time to first pixel for new and resized windows:
+//
+//   showToExpose:  show() to the first expose event
+//   exposeToPaint: first expose event to the first paint event
+//   resizeToPaint: setGeometry() to the first paint at the new size
+//
+// Each test runs LATENCY_ITERATIONS iterations (default 200) per window
+// configuration and update driver, and prints the latency distribution.
+// The benchmark result is the median. Event times are taken from the
+// TestWindowTrace and are not affected by the wait polling interval.
+
+class tst_bench_windowlatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase_data();
+    void initTestCase();
+    void init();
+    void showToExpose_data() { windowConfigurations(); }
+    void showToExpose();
+    void exposeToPaint_data() { windowConfigurations(); }
+    void exposeToPaint();
+    void resizeToPaint_data() { windowConfigurations(); }
+    void resizeToPaint();
+
+private:
+    void windowConfigurations();
+    void measureShow(TestWindow::WindowConfiguration configuration,
+                     QVector<qint64> *showToExpose, QVector<qint64> *exposeToPaint);
+    void report(QVector<qint64> samples);
+
+    int iterations;
+};
+
+// Timestamp of the first event of the given type recorded at or after fromNs, or -1.
+// With a paintSize, only paints at that size (in device independent pixels) match.
+static qint64 firstEventNs(const TestWindowTrace &trace, TestWindow::EventType type, qint64 fromNs,
+                           QSize paintSize = QSize(), qreal devicePixelRatio = 1.0)
+{
+    for (int i = 0; i < trace.count(); ++i) {
+        const TestWindowTraceEvent &event = trace.at(i);
+        if (event.type != type || event.timestampNs < fromNs)
+            continue;
+        if (paintSize.isValid()) {
+            // OpenGL windows always repaint fully and record their framebuffer size.
+            QSize size = event.framebufferSize.isValid() ? event.framebufferSize : event.paintRect.size();
+            QSize expected = event.framebufferSize.isValid() ? paintSize * devicePixelRatio : paintSize;
+            if (size != expected)
+                continue;
+        }
+        return event.timestampNs;
+    }
+    return -1;
+}
+
+void tst_bench_windowlatency::initTestCase_data()
+{
+    QTest::addColumn<bool>("displaylink");
+#ifdef HAVE_CVDISPLAYLINK
+    QTest::newRow("displaylink_update") << true;
+#endif
+    QTest::newRow("timer_update") << false;
+}
+
+void tst_bench_windowlatency::initTestCase()
+{
+    // Pooled windows are already open natively, which is not what we want to measure.
+    TestWindow::setPoolEnabled(false);
+
+    iterations = qEnvironmentVariableIsSet("LATENCY_ITERATIONS")
+               ? qMax(1, qEnvironmentVariableIntValue("LATENCY_ITERATIONS")) : 200;
+}
+
+void tst_bench_windowlatency::init()
+{
+    QFETCH_GLOBAL(bool, displaylink);
+    qputenv("QT_MAC_ENABLE_CVDISPLAYLINK", displaylink ? QByteArray("1") : QByteArray("0"));
+}
+
+void tst_bench_windowlatency::windowConfigurations()
+{
+    QTest::addColumn<TestWindow::WindowConfiguration>("windowconfiguration");
+    WINDOW_CONFIGS {
+        QTest::newRow(TestWindow::windowConfigurationName(WINDOW_CONFIG).constData()) << WINDOW_CONFIG;
+    }
+}
+
+void tst_bench_windowlatency::measureShow(TestWindow::WindowConfiguration configuration,
+                                          QVector<qint64> *showToExpose, QVector<qint64> *exposeToPaint)
+{
+    for (int i = 0; i < iterations; ++i) @autoreleasepool {
+        TestWindow *window = TestWindow::createWindow(configuration);
+        window->setGeometry(QRect(100, 100, 200, 200));
+
+        qint64 showNs = QNativeInput::monotonicNs();
+        window->show();
+        bool painted = window->waitForEvent(TestWindow::PaintEvent);
+
+        qint64 exposeNs = firstEventNs(window->trace(), TestWindow::ExposeEvent, showNs);
+        qint64 paintNs = firstEventNs(window->trace(), TestWindow::PaintEvent, exposeNs);
+        delete window;
+
+        if (!painted || exposeNs < 0 || paintNs < 0) {
+            qWarning() << "No expose and paint for iteration" << i;
+            continue;
+        }
+        if (showToExpose)
+            showToExpose->append(exposeNs - showNs);
+        if (exposeToPaint)
+            exposeToPaint->append(paintNs - exposeNs);
+    }
+}
+
+void tst_bench_windowlatency::report(QVector<qint64> samples)
+{
+    QVERIFY2(!samples.isEmpty(), "no samples");
+    std::sort(samples.begin(), samples.end());
+    auto percentileMs = [&samples](int percentile) {
+        int rank = qMax(1, int(std::ceil(percentile / 100.0 * samples.size())));
+        return samples.at(qMin(rank, samples.size()) - 1) / 1e6;
+    };
+
+    qDebug() << qPrintable(QString("%1 samples, min %2 ms, p50 %3 ms, p90 %4 ms, p99 %5 ms, max %6 ms")
+        .arg(samples.size()).arg(samples.first() / 1e6, 0, 'f', 2)
+        .arg(percentileMs(50), 0, 'f', 2).arg(percentileMs(90), 0, 'f', 2)
+        .arg(percentileMs(99), 0, 'f', 2).arg(samples.last() / 1e6, 0, 'f', 2));
+    QTest::setBenchmarkResult(percentileMs(50), QTest::WalltimeMilliseconds);
+}
+
+void tst_bench_windowlatency::showToExpose()
+{
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+    QVector<qint64> samples;
+    measureShow(windowconfiguration, &samples, 0);
+    report(samples);
+}
+
+void tst_bench_windowlatency::exposeToPaint()
+{
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+    QVector<qint64> samples;
+    measureShow(windowconfiguration, 0, &samples);
+    report(samples);
+}
+
+void tst_bench_windowlatency::resizeToPaint()
+{
+    QFETCH(TestWindow::WindowConfiguration, windowconfiguration);
+
+    TestWindow *window = TestWindow::createWindow(windowconfiguration);
+    window->setGeometry(QRect(100, 100, 200, 200));
+    window->show();
+    waitForWindowVisible(window);
+
+    // Alternate between two sizes so that every iteration is a real resize.
+    QVector<qint64> samples;
+    for (int i = 0; i < iterations; ++i) @autoreleasepool {
+        QRect geometry(100, 100, (i % 2) ? 200 : 300, (i % 2) ? 200 : 250);
+
+        window->resetCounters();
+        qint64 resizeNs = QNativeInput::monotonicNs();
+        window->setGeometry(geometry);
+
+        // Earlier paints may still be for the old size.
+        qint64 paintNs = -1;
+        for (int count = 1; paintNs < 0 && window->waitForEvent(TestWindow::PaintEvent, count); ++count)
+            paintNs = firstEventNs(window->trace(), TestWindow::PaintEvent, resizeNs, geometry.size(),
+                                   window->qwindow()->devicePixelRatio());
+
+        if (paintNs < 0) {
+            qWarning() << "No paint at" << geometry.size() << "for iteration" << i;
+            continue;
+        }
+        samples.append(paintNs - resizeNs);
+    }
+
+    delete window;
+    report(samples);
+}
+
+QTEST_MAIN(tst_bench_windowlatency)
+#include "tst_bench_windowlatency.moc"
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = tst_bench_windowlatency
+
+QT = core gui gui-private testlib
+CONFIG += c++11
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+include($$PWD/../../auto/qcocoawindow/testsupport.pri)
+
+OBJECTIVE_SOURCES += tst_bench_windowlatency.mm
+
+# Comment in for Qt branches that have the display link update driver.
+#DEFINES += HAVE_CVDISPLAYLINK
@@ -0,0 +1,340 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QtQuick>
+#include <QQuickWidget>
+#include <climits>
+#include <time.h>
+#ifdef Q_OS_MAC
+#include <mach/mach.h>
+#endif
+
+#include "openglwindow.h"
+#include "rasterwindow.h"
+#include "widgetwindow.h"
+#include "qtcontent.h"
+
+// Many-window scaling for the testbench content types. Shows N animating
+// top-level instances of each content type, for N = 1, 2, 4 ... 64, and
+// measures for SCALING_DURATION milliseconds (default 2000):
+//
+//   - aggregate and per-window (min/average) frame rate
+//   - GUI thread CPU time, as percent of one core
+//   - resident memory growth per window
+//
+// The OpenGL content types animate themselves (g_animate). The other
+// types are kept animating by requesting a new frame after each frame.
+// The benchmark result is the aggregate frame rate.
+//
+// The windows are shown, on screen by default. For a headless run use the
+// offscreen platform (-platform offscreen or QT_QPA_PLATFORM=offscreen);
+// content types that need OpenGL are skipped when the platform can't
+// create an OpenGL context.
+
+bool g_animate = true; // read by the testbench OpenGL content
+
+enum ContentType
+{
+    RasterWindowContent,
+    OpenGLWindowContent,
+    RedWidgetContent,
+    QtOpenGLWidgetContent,
+    QQuickViewContent,
+    QQuickWidgetContent,
+    ContentTypeCount
+};
+Q_DECLARE_METATYPE(ContentType)
+
+static const char *contentTypeNames[ContentTypeCount] =
+{
+    "RasterWindow", "OpenGLWindow", "RedWidget", "QtOpenGLWidget", "QQuickView", "QQuickWidget"
+};
+
+// RasterWindow that reports each completed paint. An UpdateRequest with
+// nothing dirty paints nothing, so frames are counted here.
+class ScalingRasterWindow : public RasterWindow
+{
+    Q_OBJECT
+signals:
+    void painted();
+protected:
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE
+    {
+        RasterWindow::paintEvent(event);
+        emit painted();
+    }
+};
+
+// One content instance, shown as a top-level window, and its frame counter.
+class ScalingContent : public QObject
+{
+    Q_OBJECT
+public:
+    ScalingContent(ContentType type, QRect geometry);
+    ~ScalingContent();
+
+    int frames() const { return frameCount.load(); }
+    void resetFrames() { frameCount.store(0); }
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) Q_DECL_OVERRIDE;
+
+private slots:
+    void frameDone();
+    void requestFrame();
+
+private:
+    ContentType type;
+    QWindow *window;
+    QWidget *widget;
+    QAtomicInt frameCount;
+};
+
+ScalingContent::ScalingContent(ContentType type, QRect geometry)
+    : type(type)
+    , window(0)
+    , widget(0)
+{
+    const QUrl qmlSource = QUrl::fromLocalFile(QStringLiteral(TESTBENCH_DIR "/main.qml"));
+
+    switch (type) {
+        case RasterWindowContent: {
+            ScalingRasterWindow *rasterWindow = new ScalingRasterWindow();
+            connect(rasterWindow, &ScalingRasterWindow::painted, this, &ScalingContent::frameDone);
+            window = rasterWindow;
+            break; }
+        case OpenGLWindowContent: {
+            OpenGLWindow *openglWindow = new OpenGLWindow();
+            connect(openglWindow, &QOpenGLWindow::frameSwapped, this, &ScalingContent::frameDone);
+            window = openglWindow;
+            break; }
+        case RedWidgetContent:
+            widget = new RedWidget();
+            widget->installEventFilter(this);
+            break;
+        case QtOpenGLWidgetContent: {
+            QtOpenGLWidget *openglWidget = new QtOpenGLWidget();
+            connect(openglWidget, &QOpenGLWidget::frameSwapped, this, &ScalingContent::frameDone);
+            widget = openglWidget;
+            break; }
+        case QQuickViewContent: {
+            QQuickView *view = new QQuickView();
+            view->setResizeMode(QQuickView::SizeRootObjectToView);
+            view->setSource(qmlSource);
+            // Emitted on the render thread with the threaded render loop.
+            connect(view, &QQuickWindow::afterRendering, this, &ScalingContent::frameDone, Qt::DirectConnection);
+            window = view;
+            break; }
+        case QQuickWidgetContent: {
+            QQuickWidget *quickWidget = new QQuickWidget();
+            quickWidget->setResizeMode(QQuickWidget::SizeRootObjectToView);
+            quickWidget->setSource(qmlSource);
+            connect(quickWidget->quickWindow(), &QQuickWindow::afterRendering,
+                    this, &ScalingContent::frameDone, Qt::DirectConnection);
+            widget = quickWidget;
+            break; }
+        default:
+            break;
+    }
+
+    if (window) {
+        window->setGeometry(geometry);
+        window->show();
+    } else if (widget) {
+        widget->setGeometry(geometry);
+        widget->show();
+    }
+}
+
+ScalingContent::~ScalingContent()
+{
+    delete window;
+    delete widget;
+}
+
+bool ScalingContent::eventFilter(QObject *watched, QEvent *event)
+{
+    if (type == RedWidgetContent && event->type() == QEvent::Paint)
+        frameDone();
+    return QObject::eventFilter(watched, event);
+}
+
+void ScalingContent::frameDone()
+{
+    frameCount.ref();
+
+    // Ask for the next frame once this one has been handled. The OpenGL
+    // content types request their next frame from paintGL().
+    if (type != OpenGLWindowContent && type != QtOpenGLWidgetContent)
+        QMetaObject::invokeMethod(this, "requestFrame", Qt::QueuedConnection);
+}
+
+void ScalingContent::requestFrame()
+{
+    if (!g_animate)
+        return;
+    switch (type) {
+        case RasterWindowContent:
+            // QPaintDeviceWindow ignores requestUpdate() with nothing dirty;
+            // update() marks the window dirty and requests the update.
+            static_cast<RasterWindow *>(window)->update();
+            break;
+        case RedWidgetContent:
+            widget->update();
+            break;
+        case QQuickViewContent:
+            static_cast<QQuickWindow *>(window)->update();
+            break;
+        case QQuickWidgetContent:
+            static_cast<QQuickWidget *>(widget)->quickWindow()->update();
+            break;
+        default:
+            break;
+    }
+}
+
+static bool needsOpenGL(ContentType type)
+{
+    return type != RasterWindowContent && type != RedWidgetContent;
+}
+
+static bool canCreateOpenGLContext()
+{
+    QOpenGLContext context;
+    return context.create();
+}
+
+static qint64 guiThreadCpuTimeNs()
+{
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static qint64 residentBytes()
+{
+#ifdef Q_OS_MAC
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+#else
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return 0;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * 4096 : 0;
+#endif
+}
+
+class tst_bench_windowscaling : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void scaling_data();
+    void scaling();
+};
+
+void tst_bench_windowscaling::scaling_data()
+{
+    QTest::addColumn<ContentType>("contentType");
+    QTest::addColumn<int>("windowCount");
+    for (int type = 0; type < ContentTypeCount; ++type) {
+        for (int count = 1; count <= 64; count *= 2) {
+            QByteArray name = QByteArray(contentTypeNames[type]) + '_' + QByteArray::number(count);
+            QTest::newRow(name.constData()) << ContentType(type) << count;
+        }
+    }
+}
+
+void tst_bench_windowscaling::scaling()
+{
+    QFETCH(ContentType, contentType);
+    QFETCH(int, windowCount);
+
+    if (needsOpenGL(contentType) && !canCreateOpenGLContext())
+        QSKIP("The platform can't create an OpenGL context");
+
+    int durationMs = qEnvironmentVariableIsSet("SCALING_DURATION")
+                   ? qEnvironmentVariableIntValue("SCALING_DURATION") : 2000;
+
+    qint64 baselineBytes = residentBytes();
+
+    // Cascade the windows in a grid of 8 columns.
+    QList<ScalingContent *> contents;
+    for (int i = 0; i < windowCount; ++i) {
+        QRect geometry(QPoint(20 + (i % 8) * 170, 40 + (i / 8) * 130), QSize(160, 120));
+        contents.append(new ScalingContent(contentType, geometry));
+    }
+
+    // Warm up: first expose, QML loading and shader compilation.
+    QTest::qWait(500);
+
+    foreach (ScalingContent *content, contents)
+        content->resetFrames();
+    QElapsedTimer timer;
+    timer.start();
+    qint64 cpuStartNs = guiThreadCpuTimeNs();
+    QTest::qWait(durationMs);
+    qint64 cpuNs = guiThreadCpuTimeNs() - cpuStartNs;
+    qint64 elapsedNs = timer.nsecsElapsed();
+
+    int totalFrames = 0;
+    int minFrames = INT_MAX;
+    foreach (ScalingContent *content, contents) {
+        int frames = content->frames();
+        totalFrames += frames;
+        minFrames = qMin(minFrames, frames);
+    }
+    qint64 grownBytes = residentBytes() - baselineBytes;
+
+    qDeleteAll(contents);
+
+    qreal seconds = elapsedNs / 1e9;
+    qreal aggregateFps = totalFrames / seconds;
+    qDebug() << qPrintable(QString("%1 x %2: %3 fps aggregate, per window avg %4 min %5 fps, "
+                                   "GUI thread CPU %6%, %7 KB per window")
+        .arg(windowCount).arg(contentTypeNames[contentType])
+        .arg(aggregateFps, 0, 'f', 1)
+        .arg(aggregateFps / windowCount, 0, 'f', 1).arg(minFrames / seconds, 0, 'f', 1)
+        .arg(100.0 * cpuNs / elapsedNs, 0, 'f', 1)
+        .arg(grownBytes / 1024 / windowCount));
+    QTest::setBenchmarkResult(aggregateFps, QTest::FramesPerSecond);
+}
+
+QTEST_MAIN(tst_bench_windowscaling)
+#include "tst_bench_windowscaling.moc"
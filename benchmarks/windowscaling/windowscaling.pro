@@ -0,0 +1,29 @@
+TEMPLATE = app
+TARGET = tst_bench_windowscaling
+
+QT = core gui widgets quick quickwidgets testlib
+CONFIG += c++11
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+# testbench content types
+TESTBENCH = $$PWD/../../manual/testbench
+INCLUDEPATH += $$TESTBENCH
+DEFINES += TESTBENCH_DIR=\\\"$$TESTBENCH\\\"
+HEADERS += \
+    $$TESTBENCH/glcontent.h \
+    $$TESTBENCH/openglwindow.h \
+    $$TESTBENCH/rasterwindow.h \
+    $$TESTBENCH/widgetwindow.h \
+    $$TESTBENCH/qtcontent.h \
+    $$TESTBENCH/workload.h
+SOURCES += \
+    $$TESTBENCH/glcontent.cpp \
+    $$TESTBENCH/openglwindow.cpp \
+    $$TESTBENCH/rasterwindow.cpp \
+    $$TESTBENCH/widgetwindow.cpp \
+    $$TESTBENCH/qtcontent.cpp \
+    $$TESTBENCH/workload.cpp
+
+SOURCES += tst_bench_windowscaling.cpp
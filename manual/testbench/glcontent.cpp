@@ -1,4 +1,8 @@
-#include <QtGui/QtGui>
+#include "glcontent.h"
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 void drawSimpleGLContent(int frame)
 {
@@ -16,23 +20,243 @@ void drawSimpleGLContent(int frame)
     glEnd();
 }
 
-static QColor colorTable[] =
+static const QRgb colorTable[] =
 {
-    QColor("#309f8f"),
-    QColor("#a2bff2"),
-    QColor("#c0ef8f")
+    0xff309f8f,
+    0xffa2bff2,
+    0xffc0ef8f
 };
 
+static QRgb backgroundColor(int frame)
+{
+    return colorTable[frame % (sizeof(colorTable) / sizeof(colorTable[0]))];
+}
+
+// Fills count pixels with value. The colors are opaque, which means that
+// the result is identical for RGB32, ARGB32 and ARGB32_Premultiplied.
+static void fillSolid(quint32 *dst, int count, quint32 value)
+{
+#ifdef __SSE2__
+    for (; count > 0 && (quintptr(dst) & 15); --count)
+        *dst++ = value;
+    const __m128i v = _mm_set1_epi32(int(value));
+    for (; count >= 16; count -= 16, dst += 16) {
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst), v);
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + 4), v);
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + 8), v);
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst + 12), v);
+    }
+    for (; count >= 4; count -= 4, dst += 4)
+        _mm_store_si128(reinterpret_cast<__m128i *>(dst), v);
+#endif
+    for (; count > 0; --count)
+        *dst++ = value;
+}
+
+static bool isSolidFillFormat(QImage::Format format)
+{
+    return format == QImage::Format_RGB32 || format == QImage::Format_ARGB32
+        || format == QImage::Format_ARGB32_Premultiplied;
+}
+
+// Writes to the image data in place, like an active QPainter on the image
+// does. scanLine() would detach (copy) an image that is shared.
+static void fillSolid(QImage *image, QRect rect, QRgb color)
+{
+    rect &= image->rect();
+    uchar *bits = const_cast<uchar *>(image->constBits());
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+        fillSolid(reinterpret_cast<quint32 *>(bits + y * image->bytesPerLine()) + rect.x(), rect.width(), color);
+}
+
 void drawSimplePainterContent(QPainter *p, int frame, QSize size)
 {
-    QColor backgroundColor = colorTable[frame % (sizeof(colorTable) / sizeof(colorTable[0]))].rgba();
-    p->fillRect(QRect(QPoint(), size), backgroundColor);
+    QRgb color = backgroundColor(frame);
+
+    // Fill the image directly when that gives the same pixels as QPainter:
+    // a plain image device, no clipping, and an integral scale/translate
+    // transform (for example the devicePixelRatio scale of a backing store).
+    QPaintEngine *engine = p->paintEngine();
+    QPaintDevice *device = engine ? engine->paintDevice() : 0;
+    const QTransform &transform = p->deviceTransform();
+    if (device && device->devType() == QInternal::Image
+        && engine->type() == QPaintEngine::Raster && engine->systemClip().isEmpty()
+        && !p->hasClipping() && p->opacity() == 1.0
+        && p->compositionMode() == QPainter::CompositionMode_SourceOver
+        && transform.type() <= QTransform::TxScale) {
+        QImage *image = static_cast<QImage *>(device);
+        QRectF deviceRect = transform.mapRect(QRectF(QPointF(0, 0), size));
+        if (isSolidFillFormat(image->format()) && deviceRect == QRectF(deviceRect.toAlignedRect())) {
+            fillSolid(image, deviceRect.toAlignedRect(), color);
+            return;
+        }
+    }
+
+    p->fillRect(QRect(QPoint(), size), QColor::fromRgba(color));
+}
+
+// Recycled images for drawSimpleImageContent(), GUI thread only. An image
+// is reused once the caller has released all copies of it.
+static QList<QImage> imagePool;
+static const int imagePoolSize = 4;
+
+static QImage *pooledImage(QSize size, QImage::Format format)
+{
+    for (int i = 0; i < imagePool.size(); ++i) {
+        QImage &image = imagePool[i];
+        if (image.size() == size && image.format() == format && image.isDetached())
+            return &image;
+    }
+    if (imagePool.size() >= imagePoolSize)
+        imagePool.removeFirst();
+    imagePool.append(QImage(size, format));
+    return &imagePool.last();
 }
 
 QImage drawSimpleImageContent(int frame, QSize size)
 {
-    QImage image(size, QImage::Format_ARGB32_Premultiplied);
-    QPainter p(&image);
-    drawSimplePainterContent(&p, frame, size);
-    return image;
+    QImage *image = pooledImage(size, QImage::Format_ARGB32_Premultiplied);
+    fillSolid(image, image->rect(), backgroundColor(frame));
+    return *image;
+}
+
+static const char *coreVertexShader =
+    "#version 330 core\n"
+    "in vec2 position;\n"
+    "in vec3 instance; // xy: grid cell center, z: scale\n"
+    "uniform float angle;\n"
+    "void main() {\n"
+    "    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));\n"
+    "    gl_Position = vec4(rotation * position * instance.z + instance.xy, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *coreFragmentShader =
+    "#version 330 core\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragColor = vec4(0.7, 0.4, 0.4, 1.0);\n"
+    "}\n";
+
+GLContentRenderer::GLContentRenderer(int triangleCount)
+    : program(0)
+    , vertexBuffer(QOpenGLBuffer::VertexBuffer)
+    , instanceBuffer(QOpenGLBuffer::VertexBuffer)
+    , count(0)
+    , uploadedCount(0)
+    , initialized(false)
+    , failed(false)
+{
+    setTriangleCount(triangleCount);
+}
+
+GLContentRenderer::~GLContentRenderer()
+{
+    delete program;
+    vao.destroy();
+    vertexBuffer.destroy();
+    instanceBuffer.destroy();
+}
+
+QSurfaceFormat GLContentRenderer::format()
+{
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    return format;
+}
+
+int GLContentRenderer::defaultTriangleCount()
+{
+    return qBound(0, qEnvironmentVariableIntValue("TESTBENCH_GL_TRIANGLES"), int(MaxTriangleCount));
+}
+
+void GLContentRenderer::setTriangleCount(int triangleCount)
+{
+    count = qBound(1, triangleCount, int(MaxTriangleCount));
+}
+
+bool GLContentRenderer::initialize()
+{
+    initialized = true;
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context || context->format().version() < qMakePair(3, 3)
+        || context->format().profile() != QSurfaceFormat::CoreProfile) {
+        qWarning() << "GLContentRenderer: needs a 3.3 core profile context, got"
+                   << (context ? context->format() : QSurfaceFormat());
+        return false;
+    }
+
+    program = new QOpenGLShaderProgram;
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, coreVertexShader);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, coreFragmentShader);
+    program->bindAttributeLocation("position", 0);
+    program->bindAttributeLocation("instance", 1);
+    if (!program->link()) {
+        qWarning() << "GLContentRenderer: shader link failed:" << program->log();
+        return false;
+    }
+
+    QOpenGLExtraFunctions *f = context->extraFunctions();
+    vao.create();
+    vao.bind();
+
+    // The drawSimpleGLContent() triangle.
+    const GLfloat triangle[] = { 0.0f, 0.6f, -0.3f, -0.3f, 0.3f, -0.3f };
+    vertexBuffer.create();
+    vertexBuffer.bind();
+    vertexBuffer.allocate(triangle, sizeof(triangle));
+    f->glEnableVertexAttribArray(0);
+    f->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    instanceBuffer.create();
+    instanceBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    instanceBuffer.bind();
+    f->glEnableVertexAttribArray(1);
+    f->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    f->glVertexAttribDivisor(1, 1);
+
+    vao.release();
+    return true;
+}
+
+// Lays the triangles out on a square grid covering the viewport. A single
+// triangle fills the viewport like drawSimpleGLContent() does.
+void GLContentRenderer::uploadInstances()
+{
+    int side = int(std::ceil(std::sqrt(double(count))));
+    float cell = 2.0f / side;
+    QVector<GLfloat> instances;
+    instances.reserve(count * 3);
+    for (int i = 0; i < count; ++i) {
+        instances.append(-1.0f + cell * (i % side + 0.5f));
+        instances.append(1.0f - cell * (i / side + 0.5f));
+        instances.append(cell / 2.0f);
+    }
+
+    instanceBuffer.bind();
+    instanceBuffer.allocate(instances.constData(), instances.size() * sizeof(GLfloat));
+    instanceBuffer.release();
+    uploadedCount = count;
+}
+
+void GLContentRenderer::render(int frame)
+{
+    if (!initialized)
+        failed = !initialize();
+    if (failed)
+        return;
+    if (uploadedCount != count)
+        uploadInstances();
+
+    QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+    f->glClearColor(0, 0, 0.5, 1.0);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+
+    program->bind();
+    program->setUniformValue("angle", GLfloat(qDegreesToRadians(double(frame % 360))));
+    vao.bind();
+    f->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, count);
+    vao.release();
+    program->release();
 }
@@ -1,5 +1,46 @@
+#ifndef GLCONTENT_H
+#define GLCONTENT_H
+
 #include <QtGui/QtGui>
 
 void drawSimpleGLContent(int frame);
 void drawSimplePainterContent(QPainter *p, int frame, QSize size);
 QImage drawSimpleImageContent(int frame, QSize size);
+
+// Core profile version of drawSimpleGLContent(): draws triangleCount
+// rotating triangles on a grid with a single instanced draw call. Needs
+// an OpenGL 3.3 core profile context (format()), which is available on
+// macOS and on Mesa llvmpipe. Construct, render and destroy the renderer
+// with the context current.
+class GLContentRenderer
+{
+public:
+    enum { MaxTriangleCount = 1000000 };
+
+    GLContentRenderer(int triangleCount = 1);
+    ~GLContentRenderer();
+
+    static QSurfaceFormat format();
+    // TESTBENCH_GL_TRIANGLES, or 0 for the fixed-function content.
+    static int defaultTriangleCount();
+
+    void setTriangleCount(int count);
+    int triangleCount() const { return count; }
+    void render(int frame);
+
+private:
+    Q_DISABLE_COPY(GLContentRenderer)
+    bool initialize();
+    void uploadInstances();
+
+    QOpenGLShaderProgram *program;
+    QOpenGLVertexArrayObject vao;
+    QOpenGLBuffer vertexBuffer;
+    QOpenGLBuffer instanceBuffer;
+    int count;
+    int uploadedCount;
+    bool initialized;
+    bool failed;
+};
+
+#endif
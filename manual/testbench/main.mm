@@ -35,6 +35,7 @@
 #include "openglwindow.h"
 #include "widgetwindow.h"
 #include "openglwindowresize.h"
+#include "threadedopenglwindow.h"
 #include "nativecocoaview.h"
 #include "qtcontent.h"
 #include "cocoaspy.h"
@@ -54,7 +55,7 @@
 //
 
 QSet<int> g_activeTestCases = { 0 }; // The currently active test cases (indices)
-int g_testViewCount = 1; // The number of test views to display
+int g_testViewCount = 1; // The number of test views to display (see benchmarks/windowscaling)
 bool g_animate = true; // animations enabled
 
 // QWindow configuration. This is a fuzzy concept (especially for the native view
@@ -183,7 +184,12 @@ NSTextField *g_nativeInstanceStatus = 0;
 
 - (void)changeAnimate:(id)sender {
     g_animate = ([sender state] == NSOnState);
-    // Don't [g_appDelegate recreateTestWindow]. Test cases read g_animate continuously.
+    // Don't [g_appDelegate recreateTestWindow]. Test cases read g_animate continuously,
+    // except for the render threads, which are told.
+    foreach (QWindow *window, QGuiApplication::allWindows()) {
+        if (ThreadedOpenGLWindow *threaded = qobject_cast<ThreadedOpenGLWindow *>(window))
+            threaded->setAnimating(g_animate);
+    }
 }
 
 - (void)changeInstanceCount:(int)newInstanceCount {
@@ -294,7 +300,8 @@ TestBenchControllerView *theControllerViewHack = 0; // There is only one, so OK.
                       << "Qt Masked Window"
                       << "Qt QtQuickWindow"
                       << "Qt QOpenGLWidget"
-                      << "Qt QtQuickWidget";
+                      << "Qt QtQuickWidget"
+                      << "Qt Threaded OpenGLWindow";
 
     [self addCheckBoxGroup:testCases
              withActionTarget:@selector(updateTestCases:)];
@@ -582,6 +589,13 @@ NSView *getEmbeddableView(QWindow *qtWindow)
     }
 }
 
+// test ThreadedOpenGLWindow: render thread per window
+- (void) qtThreadedOpenGLWindow
+{
+    for (int i = 0; i < g_testViewCount; ++i)
+        [self addChildWindow: new ThreadedOpenGLWindow()];
+}
+
 - (void) recreateTestWindow
 {
     // Save current test window geometry or set up default geometry
@@ -643,6 +657,7 @@ NSView *getEmbeddableView(QWindow *qtWindow)
             case 9: [self qtQuickWindow]; break;
             case 10: [self qtOpenGLWidget]; break;
             case 11: [self qtQuickWidget]; break;
+            case 12: [self qtThreadedOpenGLWindow]; break;
             default: break;
         }
     }
@@ -6,14 +6,41 @@ extern bool g_animate;
 
 OpenGLWindow::OpenGLWindow()
     : QOpenGLWindow(QOpenGLWindow::NoPartialUpdate)
+    , workload(WorkloadParameters::fromEnvironment())
 {
     frame = 0;
+    renderer = 0;
+
+    // Opt in to the core profile renderer with TESTBENCH_GL_TRIANGLES=<count>.
+    triangleCount = GLContentRenderer::defaultTriangleCount();
+    if (triangleCount > 0)
+        setFormat(GLContentRenderer::format());
+}
+
+OpenGLWindow::~OpenGLWindow()
+{
+    if (renderer) {
+        makeCurrent();
+        delete renderer;
+        doneCurrent();
+    }
 }
 
 void OpenGLWindow::paintGL()
 {
 //    qDebug() << "paintGL" << this;
-    drawSimpleGLContent(frame);
+    if (triangleCount > 0) {
+        if (!renderer)
+            renderer = new GLContentRenderer(triangleCount);
+        renderer->render(frame);
+    } else {
+        drawSimpleGLContent(frame);
+    }
+    // Workload from TESTBENCH_WORKLOAD, through the OpenGL paint engine.
+    if (!workload.isEmpty()) {
+        QPainter p(this);
+        workload.paint(&p, size(), frame);
+    }
     if (g_animate) {
         ++frame;
         update();
@@ -2,6 +2,9 @@
 #define OPENGLWINDOW_H
 
 #include <QOpenGLWindow>
+#include "workload.h"
+
+class GLContentRenderer;
 
 class OpenGLWindow : public QOpenGLWindow
 {
@@ -9,12 +12,16 @@ class OpenGLWindow : public QOpenGLWindow
 
 public:
     OpenGLWindow();
+    ~OpenGLWindow();
 
 protected:
     void paintGL() Q_DECL_OVERRIDE;
     void resizeGL(int w, int h) Q_DECL_OVERRIDE;
 private:
     int frame;
+    int triangleCount;
+    GLContentRenderer *renderer;
+    Workload workload;
 };
 
 #endif
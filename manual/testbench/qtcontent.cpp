@@ -7,7 +7,22 @@ QtOpenGLWidget::QtOpenGLWidget(const QByteArray &property)
 :QOpenGLWidget(0)
 {
     setProperty(property.constData(), true);
+    frame = 0;
+    renderer = 0;
 
+    // Opt in to the core profile renderer with TESTBENCH_GL_TRIANGLES=<count>.
+    triangleCount = GLContentRenderer::defaultTriangleCount();
+    if (triangleCount > 0)
+        setFormat(GLContentRenderer::format());
+}
+
+QtOpenGLWidget::~QtOpenGLWidget()
+{
+    if (renderer) {
+        makeCurrent();
+        delete renderer;
+        doneCurrent();
+    }
 }
 
 void QtOpenGLWidget::initializeGL()
@@ -22,7 +37,13 @@ void QtOpenGLWidget::resizeGL(int w, int h)
 
 void QtOpenGLWidget::paintGL()
 {
-    drawSimpleGLContent(frame);
+    if (triangleCount > 0) {
+        if (!renderer)
+            renderer = new GLContentRenderer(triangleCount);
+        renderer->render(frame);
+    } else {
+        drawSimpleGLContent(frame);
+    }
     if (g_animate) {
         ++frame;
         update();
@@ -4,15 +4,20 @@
 #include <QtWidgets>
 #include <QtQuick>
 
+class GLContentRenderer;
+
 class QtOpenGLWidget : public QOpenGLWidget
 {
 public:
     QtOpenGLWidget(const QByteArray &property = QByteArray());
+    ~QtOpenGLWidget();
     void initializeGL();
     void resizeGL(int w, int h);
     void paintGL();
 private:
     int frame;
+    int triangleCount;
+    GLContentRenderer *renderer;
 };
 
 #endif
@@ -34,7 +34,7 @@
 #include "rasterwindow.h"
 #include "glcontent.h"
 
-//#define HAVE_PARTIAL_UPDATE
+extern bool g_animate;
 
 #include <QBackingStore>
 #include <QPainter>
@@ -53,7 +53,10 @@ RasterWindow::RasterWindow(QRasterWindow *parent)
     : QRasterWindow(parent)
     , m_backgroundColorIndex(0)
     , m_mousePressed(false)
+    , m_partialUpdate(false)
     , m_rect(0, 0, 40, 40)
+    , m_workload(WorkloadParameters::fromEnvironment())
+    , m_frame(0)
 {
     initialize();
 }
@@ -62,6 +65,35 @@ void RasterWindow::initialize()
 {
 }
 
+void RasterWindow::setPartialUpdate(bool enable)
+{
+    m_partialUpdate = enable;
+    update();
+}
+
+// Returns the region to repaint for two dirty rects. Each rect in the
+// region costs a paint and a flush call, modeled as rectOverhead pixels.
+// The rects are merged into their bounding rect when painting the extra
+// pixels is cheaper than the overhead of painting them separately, for
+// example for the overlapping old and new position of a small move.
+QRegion RasterWindow::mergeDirtyRects(const QRect &a, const QRect &b)
+{
+    const int rectOverhead = 32 * 32;
+
+    if (a.isEmpty() || b.isEmpty())
+        return QRegion(a.isEmpty() ? b : a);
+
+    QRect bounds = a | b;
+    qint64 mergedCost = qint64(bounds.width()) * bounds.height() + rectOverhead;
+    qint64 separateCost = qint64(a.width()) * a.height() + qint64(b.width()) * b.height()
+                        + 2 * rectOverhead;
+    if (mergedCost <= separateCost)
+        return QRegion(bounds);
+
+    // QRegion splits overlapping rects into non-overlapping bands.
+    return QRegion(a) | QRegion(b);
+}
+
 void RasterWindow::mousePressEvent(QMouseEvent *event)
 {
     m_mousePressed = true;
@@ -75,12 +107,10 @@ void RasterWindow::mouseMoveEvent(QMouseEvent *event)
     QRect oldRect = m_rect;
     m_rect.moveCenter(event->pos());
 
-#ifdef HAVE_PARTIAL_UPDATE
-    update(oldRect);
-    update(m_rect);
-#else
-    update();
-#endif
+    if (m_partialUpdate)
+        update(mergeDirtyRects(oldRect, m_rect));
+    else
+        update();
 }
 
 void RasterWindow::mouseReleaseEvent(QMouseEvent *event)
@@ -114,6 +144,21 @@ void RasterWindow::paintEvent(QPaintEvent *event)
 {
 //    qDebug() << "paintEvent" << event->rect();
     QPainter p(this);
+    // Workload from TESTBENCH_WORKLOAD, animated with g_animate. Its items
+    // move over the whole window, so an animating workload damages all of it.
+    const bool animateWorkload = !m_workload.isEmpty() && g_animate;
+    // Paint the damaged region only.
+    if (m_partialUpdate && !animateWorkload)
+        p.setClipRegion(event->region());
     drawSimplePainterContent(&p, m_backgroundColorIndex, this->size());
+    if (!m_workload.isEmpty())
+        m_workload.paint(&p, size(), m_frame);
     p.fillRect(m_rect, Qt::gray);
+
+    if (animateWorkload) {
+        ++m_frame;
+        // Adds the workload damage to the dirty region; the paint is
+        // scheduled with requestUpdate(), paced by the platform.
+        update(QRect(QPoint(), size()));
+    }
 }
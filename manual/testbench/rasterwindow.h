@@ -33,12 +33,19 @@
 
 #include <QRasterWindow>
 #include <QImage>
+#include "workload.h"
 
 class RasterWindow : public QRasterWindow
 {
 public:
     RasterWindow(QRasterWindow *parent = 0);
 
+    // Partial update mode: dragging the rect repaints only the damaged
+    // region instead of the whole window.
+    void setPartialUpdate(bool enable);
+    bool partialUpdate() const { return m_partialUpdate; }
+    static QRegion mergeDirtyRects(const QRect &a, const QRect &b);
+
 protected:
     void mousePressEvent(QMouseEvent *);
     void mouseMoveEvent(QMouseEvent *);
@@ -55,5 +62,8 @@ private:
     QString m_text;
     int m_backgroundColorIndex;
     bool m_mousePressed;
+    bool m_partialUpdate;
     QRect m_rect;
+    Workload m_workload;
+    int m_frame;
 };
@@ -8,18 +8,22 @@ HEADERS += \
     glcontent.h \
     openglwindow.h \
     openglwindowresize.h \
+    threadedopenglwindow.h \
     rasterwindow.h \
     widgetwindow.h \
     cocoaspy.h \
-    qtcontent.h
+    qtcontent.h \
+    workload.h
 
 SOURCES += \
     glcontent.cpp \
     openglwindow.cpp \
     openglwindowresize.cpp \
+    threadedopenglwindow.cpp \
     rasterwindow.cpp \
     widgetwindow.cpp \
-    qtcontent.cpp
+    qtcontent.cpp \
+    workload.cpp
 
 OBJECTIVE_SOURCES += \
     main.mm \
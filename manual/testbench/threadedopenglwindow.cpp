@@ -0,0 +1,207 @@
+#include "threadedopenglwindow.h"
+#include "glcontent.h"
+
+extern bool g_animate;
+
+class ThreadedOpenGLRenderer : public QThread
+{
+public:
+    ThreadedOpenGLRenderer(QWindow *window, QOpenGLContext *context);
+
+    void setSize(QSize pixelSize);
+    void setExposed(bool exposed);
+    void setAnimating(bool animating);
+    void stop();
+
+    QAtomicInt frames;
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QWindow *window;
+    QOpenGLContext *context;
+
+    // Shared with the GUI thread
+    QMutex mutex;
+    QWaitCondition condition;
+    QWaitCondition idleCondition; // signaled when a frame is done
+    QSize size;
+    bool exposed;
+    bool dirty;
+    bool stopping;
+    bool rendering; // a frame is in progress, the surface may be current
+    QAtomicInt animating; // also read while rendering, without the mutex
+};
+
+ThreadedOpenGLRenderer::ThreadedOpenGLRenderer(QWindow *window, QOpenGLContext *context)
+    : window(window)
+    , context(context)
+    , exposed(false)
+    , dirty(false)
+    , stopping(false)
+    , rendering(false)
+    , animating(g_animate) // constructed on the GUI thread
+{
+}
+
+void ThreadedOpenGLRenderer::setSize(QSize pixelSize)
+{
+    QMutexLocker lock(&mutex);
+    size = pixelSize;
+    dirty = true;
+    condition.wakeOne();
+}
+
+// When the window is unexposed, blocks until the render thread has finished
+// its current frame and released the surface.
+void ThreadedOpenGLRenderer::setExposed(bool isExposed)
+{
+    QMutexLocker lock(&mutex);
+    exposed = isExposed;
+    dirty = true;
+    condition.wakeOne();
+    while (!exposed && rendering)
+        idleCondition.wait(&mutex);
+}
+
+void ThreadedOpenGLRenderer::setAnimating(bool isAnimating)
+{
+    QMutexLocker lock(&mutex);
+    animating.store(isAnimating);
+    condition.wakeOne();
+}
+
+void ThreadedOpenGLRenderer::stop()
+{
+    QMutexLocker lock(&mutex);
+    stopping = true;
+    condition.wakeOne();
+}
+
+void ThreadedOpenGLRenderer::run()
+{
+    int triangleCount = GLContentRenderer::defaultTriangleCount();
+    GLContentRenderer *content = 0;
+    int frame = 0;
+
+    // No frame clock: swapBuffers() blocks until vsync and paces the loop.
+    forever {
+        QSize pixelSize;
+        {
+            QMutexLocker lock(&mutex);
+            while (!stopping && (!exposed || (!dirty && !animating.load())))
+                condition.wait(&mutex);
+            if (stopping)
+                break;
+            pixelSize = size;
+            dirty = false;
+            rendering = true;
+        }
+
+        if (!context->makeCurrent(window)) {
+            qWarning() << "ThreadedOpenGLWindow: makeCurrent failed";
+            break;
+        }
+        context->functions()->glViewport(0, 0, pixelSize.width(), pixelSize.height());
+        if (triangleCount > 0) {
+            if (!content)
+                content = new GLContentRenderer(triangleCount);
+            content->render(frame);
+        } else {
+            drawSimpleGLContent(frame);
+        }
+        context->swapBuffers(window); // blocks until the swap with swap interval 1
+        frames.ref();
+        if (animating.load())
+            ++frame;
+
+        {
+            QMutexLocker lock(&mutex);
+            if (!exposed)
+                context->doneCurrent(); // release the surface before setExposed(false) returns
+            rendering = false;
+            idleCondition.wakeAll();
+        }
+    }
+
+    // Delete the content with the context current if possible. Otherwise
+    // its GL resources are freed with the context, on the GUI thread.
+    context->makeCurrent(window);
+    delete content;
+    context->doneCurrent();
+
+    {
+        QMutexLocker lock(&mutex);
+        rendering = false; // also after a failed makeCurrent() in the loop
+        idleCondition.wakeAll();
+    }
+
+    // Hand the context back for deletion on the GUI thread.
+    context->moveToThread(QCoreApplication::instance()->thread());
+}
+
+ThreadedOpenGLWindow::ThreadedOpenGLWindow()
+    : context(0)
+    , renderer(0)
+{
+    setSurfaceType(QSurface::OpenGLSurface);
+    QSurfaceFormat surfaceFormat = GLContentRenderer::defaultTriangleCount() > 0
+        ? GLContentRenderer::format() : QSurfaceFormat::defaultFormat();
+    surfaceFormat.setSwapInterval(1); // the blocking swap paces the render thread
+    setFormat(surfaceFormat);
+}
+
+ThreadedOpenGLWindow::~ThreadedOpenGLWindow()
+{
+    if (renderer) {
+        renderer->stop();
+        renderer->wait();
+        delete renderer;
+    }
+    delete context;
+}
+
+// The render thread does not read g_animate; call this when it changes.
+void ThreadedOpenGLWindow::setAnimating(bool animating)
+{
+    if (renderer)
+        renderer->setAnimating(animating);
+}
+
+int ThreadedOpenGLWindow::frameCount() const
+{
+    return renderer ? renderer->frames.load() : 0;
+}
+
+void ThreadedOpenGLWindow::startRenderer()
+{
+    if (!QOpenGLContext::supportsThreadedOpenGL())
+        qWarning() << "ThreadedOpenGLWindow: the platform does not support threaded OpenGL";
+
+    context = new QOpenGLContext();
+    context->setFormat(requestedFormat());
+    if (!context->create()) {
+        qWarning() << "ThreadedOpenGLWindow: could not create context";
+        return;
+    }
+
+    renderer = new ThreadedOpenGLRenderer(this, context);
+    context->moveToThread(renderer);
+    renderer->setSize(size() * devicePixelRatio());
+    renderer->start();
+}
+
+void ThreadedOpenGLWindow::exposeEvent(QExposeEvent *)
+{
+    if (isExposed() && !context)
+        startRenderer();
+    if (renderer)
+        renderer->setExposed(isExposed());
+}
+
+void ThreadedOpenGLWindow::resizeEvent(QResizeEvent *)
+{
+    if (renderer)
+        renderer->setSize(size() * devicePixelRatio());
+}
@@ -0,0 +1,36 @@
+#ifndef THREADEDOPENGLWINDOW_H
+#define THREADEDOPENGLWINDOW_H
+
+#include <QtGui>
+
+class ThreadedOpenGLRenderer;
+
+// ThreadedOpenGLWindow is the render thread version of OpenGLWindow. The
+// window owns a QOpenGLContext which is moved to a dedicated render thread.
+// The thread is paced by the blocking swap alone (swap interval 1), which
+// follows vsync; a second timer-based clock would not be phase-locked to it
+// and would make frames miss alternate vsyncs. The GUI thread only handles expose, resize and input;
+// on un-expose it waits until the render thread has released the surface.
+class ThreadedOpenGLWindow : public QWindow
+{
+    Q_OBJECT
+
+public:
+    ThreadedOpenGLWindow();
+    ~ThreadedOpenGLWindow();
+
+    void setAnimating(bool animating);
+    int frameCount() const;
+
+protected:
+    void exposeEvent(QExposeEvent *) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *) Q_DECL_OVERRIDE;
+
+private:
+    void startRenderer();
+
+    QOpenGLContext *context;
+    ThreadedOpenGLRenderer *renderer;
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "workload.h"
+#include <cmath>
+
+// xorshift32: small, fast and identical on every platform.
+class WorkloadRandom
+{
+public:
+    WorkloadRandom(quint32 seed) : state(seed ? seed : 0x9e3779b9) {}
+
+    quint32 next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    qreal unit() { return (next() >> 8) / qreal(1 << 24); } // [0, 1)
+    int range(int min, int max) { return min + int(next() % quint32(max - min + 1)); }
+    QColor color(int alpha = 255) { quint32 v = next(); return QColor(v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, alpha); }
+
+private:
+    quint32 state;
+};
+
+WorkloadParameters::WorkloadParameters()
+    : seed(1)
+    , primitiveCount(0)
+    , glyphCount(0)
+    , gradientCount(0)
+    , imageCount(0)
+    , overdraw(0)
+{
+}
+
+bool WorkloadParameters::isEmpty() const
+{
+    return primitiveCount <= 0 && glyphCount <= 0 && gradientCount <= 0 && imageCount <= 0 && overdraw <= 0;
+}
+
+QString WorkloadParameters::toString() const
+{
+    return QString("primitives=%1,glyphs=%2,gradients=%3,images=%4,overdraw=%5,seed=%6")
+        .arg(primitiveCount).arg(glyphCount).arg(gradientCount).arg(imageCount).arg(overdraw).arg(seed);
+}
+
+WorkloadParameters WorkloadParameters::fromString(const QString &description)
+{
+    WorkloadParameters parameters;
+    foreach (const QString &item, description.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        QString name = item.section(QLatin1Char('='), 0, 0).trimmed();
+        QString valueString = item.section(QLatin1Char('='), 1).trimmed();
+        bool ok = false;
+        // The seed is unsigned, the counts are ints and must not be negative.
+        uint seed = 0;
+        int value = 0;
+        if (name == QLatin1String("seed")) {
+            seed = valueString.toUInt(&ok);
+        } else {
+            value = valueString.toInt(&ok);
+            ok = ok && value >= 0;
+        }
+        if (!ok)
+            qWarning() << "Workload: invalid value in" << item;
+        else if (name == QLatin1String("primitives"))
+            parameters.primitiveCount = value;
+        else if (name == QLatin1String("glyphs"))
+            parameters.glyphCount = value;
+        else if (name == QLatin1String("gradients"))
+            parameters.gradientCount = value;
+        else if (name == QLatin1String("images"))
+            parameters.imageCount = value;
+        else if (name == QLatin1String("overdraw"))
+            parameters.overdraw = value;
+        else if (name == QLatin1String("seed"))
+            parameters.seed = seed;
+        else
+            qWarning() << "Workload: unknown parameter" << name;
+    }
+    return parameters;
+}
+
+WorkloadParameters WorkloadParameters::fromEnvironment()
+{
+    return fromString(QString::fromLocal8Bit(qgetenv("TESTBENCH_WORKLOAD")));
+}
+
+WorkloadParameters WorkloadParameters::level(int level, quint32 seed)
+{
+    WorkloadParameters parameters;
+    int scale = 1 << qBound(0, level, 20);
+    parameters.seed = seed;
+    parameters.primitiveCount = 100 * scale;
+    parameters.glyphCount = 50 * scale;
+    parameters.gradientCount = 4 * scale;
+    parameters.imageCount = 4 * scale;
+    parameters.overdraw = qMin(1 + level / 2, 8);
+    return parameters;
+}
+
+Workload::Workload(const WorkloadParameters &parameters)
+{
+    setParameters(parameters);
+}
+
+void Workload::setParameters(const WorkloadParameters &parameters)
+{
+    params = parameters;
+    WorkloadRandom random(params.seed);
+
+    // Sprite for the image draws: a radial gradient disc.
+    sprite = QImage();
+    if (params.imageCount > 0) {
+        sprite = QImage(64, 64, QImage::Format_ARGB32_Premultiplied);
+        sprite.fill(Qt::transparent);
+        QPainter p(&sprite);
+        p.setRenderHint(QPainter::Antialiasing);
+        QRadialGradient gradient(QPointF(32, 32), 32);
+        QColor center = random.color();
+        gradient.setColorAt(0, center);
+        gradient.setColorAt(1, random.color(128));
+        p.setBrush(gradient);
+        p.setPen(Qt::NoPen);
+        p.drawEllipse(sprite.rect());
+    }
+
+    // Text for the glyph draws.
+    textLines.clear();
+    for (int remaining = params.glyphCount; remaining > 0; remaining -= 80) {
+        QString line;
+        for (int i = 0; i < qMin(remaining, 80); ++i) {
+            bool space = random.range(0, 5) == 0;
+            line.append(QLatin1Char(char(space ? ' ' : 'a' + random.range(0, 25))));
+        }
+        textLines.append(line);
+    }
+}
+
+void Workload::paint(QPainter *p, QSize size, int frame)
+{
+    if (isEmpty() || size.isEmpty())
+        return;
+
+    // The random sequence restarts every frame, so a frame only depends
+    // on the parameters and the frame number. Each item has a start
+    // position and a velocity, in window sizes and window sizes per frame.
+    WorkloadRandom random(params.seed);
+    const qreal w = size.width();
+    const qreal h = size.height();
+    // Random values are drawn in separate statements, since the evaluation
+    // order of function arguments is unspecified.
+    auto position = [&random, frame, w, h]() {
+        qreal x = random.unit();
+        x += (random.unit() - 0.5) * 0.01 * frame;
+        qreal y = random.unit();
+        y += (random.unit() - 0.5) * 0.01 * frame;
+        return QPointF((x - std::floor(x)) * w, (y - std::floor(y)) * h);
+    };
+    auto itemSize = [&random](int min, int maxWidth, int maxHeight) {
+        int width = random.range(min, qMax(min, maxWidth));
+        int height = random.range(min, qMax(min, maxHeight));
+        return QSizeF(width, height);
+    };
+
+    p->save();
+
+    for (int i = 0; i < params.overdraw; ++i)
+        p->fillRect(QRectF(0, 0, w, h), random.color(32));
+
+    for (int i = 0; i < params.gradientCount; ++i) {
+        QPointF pos = position();
+        QRectF rect(pos, itemSize(16, size.width() / 4, size.height() / 4));
+        QLinearGradient gradient(rect.topLeft(), rect.bottomRight());
+        QColor from = random.color();
+        gradient.setColorAt(0, from);
+        gradient.setColorAt(1, random.color(160));
+        p->fillRect(rect, gradient);
+    }
+
+    p->setPen(Qt::NoPen);
+    for (int i = 0; i < params.primitiveCount; ++i) {
+        QPointF pos = position();
+        QRectF rect(pos, itemSize(4, 64, 64));
+        int alpha = random.range(128, 255);
+        QColor color = random.color(alpha);
+        switch (i % 3) {
+        case 0:
+            p->setRenderHint(QPainter::Antialiasing, false);
+            p->fillRect(rect, color);
+            break;
+        case 1:
+            p->setRenderHint(QPainter::Antialiasing, true);
+            p->setBrush(color);
+            p->drawEllipse(rect);
+            break;
+        default:
+            p->setRenderHint(QPainter::Antialiasing, true);
+            p->setPen(QPen(color, 2));
+            p->drawLine(rect.topLeft(), rect.bottomRight());
+            p->setPen(Qt::NoPen);
+            break;
+        }
+    }
+
+    for (int i = 0; i < params.imageCount; ++i) {
+        QPointF pos = position();
+        qreal scale = 0.5 + random.unit();
+        p->drawImage(QRectF(pos, QSizeF(64 * scale, 64 * scale)), sprite);
+    }
+
+    if (!textLines.isEmpty()) {
+        QFont font = p->font();
+        font.setPixelSize(12);
+        p->setFont(font);
+        p->setPen(random.color());
+        for (int i = 0; i < textLines.size(); ++i) {
+            QPointF pos = position();
+            p->drawText(pos, textLines.at(i));
+        }
+    }
+
+    p->restore();
+}
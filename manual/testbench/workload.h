@@ -0,0 +1,51 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <QtGui/QtGui>
+
+// Parameters for a painting Workload. The default parameters describe an
+// empty workload.
+struct WorkloadParameters
+{
+    WorkloadParameters();
+
+    quint32 seed;
+    int primitiveCount;  // rects, ellipses and lines
+    int glyphCount;      // text glyphs, in lines of up to 80 characters
+    int gradientCount;   // linear gradient filled rects
+    int imageCount;      // 64x64 image draws
+    int overdraw;        // translucent full-window layers
+
+    bool isEmpty() const;
+    QString toString() const;
+    // Parses "primitives=1000,glyphs=500,gradients=20,images=10,overdraw=2,seed=1".
+    static WorkloadParameters fromString(const QString &description);
+    // TESTBENCH_WORKLOAD, in the fromString() format.
+    static WorkloadParameters fromEnvironment();
+    // A complexity sweep: level 0 is light, each level doubles the work.
+    static WorkloadParameters level(int level, quint32 seed = 1);
+};
+
+// Scalable painting workload for the testbench content and TestWindow.
+// Painting is deterministic: the same parameters, seed, frame and size
+// always produce the same drawing commands. The frame number animates
+// the positions. Paints with QPainter, which means that OpenGL windows
+// run it through the OpenGL paint engine.
+class Workload
+{
+public:
+    explicit Workload(const WorkloadParameters &parameters = WorkloadParameters());
+
+    void setParameters(const WorkloadParameters &parameters);
+    const WorkloadParameters &parameters() const { return params; }
+    bool isEmpty() const { return params.isEmpty(); }
+
+    void paint(QPainter *p, QSize size, int frame);
+
+private:
+    WorkloadParameters params;
+    QImage sprite;
+    QStringList textLines;
+};
+
+#endif